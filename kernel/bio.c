@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -12,6 +12,37 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+//
+// Each bucket of the hash table, keyed by (dev, blockno), has its
+// own lock, so lookups of different blocks don't contend. A
+// bucket's lock protects its list and its buffers' dev, blockno,
+// refcnt, lastuse and dirty.
+//
+// Buffers are recycled by 2Q, so that one big scan can't push out
+// the blocks that are used again and again. A block read in goes
+// on A1, first in first out, and stays there however often it's
+// used meanwhile. Only a block read again soon after A1 dropped
+// it, which a ghost list of A1's recent victims remembers, goes
+// on Am, where the least recently used goes first. A1 gives up
+// buffers while it holds more than a quarter of the cache.
+//
+// Each queue keeps its unused, clean buffers on an idle list, the
+// next to recycle at the tail, so the recycler needn't search the
+// buckets. A buffer leaves the list lazily: the recycler drops one
+// that has been taken meanwhile, and it goes back at the head when
+// it is unused again. An Am buffer moves to the head whenever it
+// falls unused; an A1 buffer keeps its place.
+//
+// Besides the NBUF buffers that are always there, the cache grows
+// a page of buffers at a time while free memory is above
+// BUFMINFREE pages, up to NBUFMAX buffers, and gives pages back
+// when kalloc() runs out (see breclaim).
+//
+// NBUF has to cover everyone who may hold buffers at once when the
+// cache is that small: the log's transaction being built, the one
+// the flusher is installing, and the log blocks write_log() or the
+// flusher reads (LOGSIZE each), plus a few bread_range()s of up to
+// MAXSEG blocks by readi() and writei().
 
 
 #include "types.h"
@@ -19,100 +50,532 @@
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
 
+#define NBUCKET 509
+#define BRECLAIM 8  // most pages breclaim() gives back at once
+#define NGHOST NBUFMAX
+
+// Which 2Q queue a buffer is on.
+enum { QNONE, QA1, QAM };
+
+// Buffers that fit in a page along with the link.
+#define NPAGEBUF ((PGSIZE - sizeof(void*)) / sizeof(struct buf))
+
+struct bufpage {
+  struct bufpage *next;
+  struct buf buf[NPAGEBUF];
+};
+
 struct {
-  struct spinlock lock;
+  // Held while recycling a buffer, which takes a second bucket's
+  // lock; with only one recycler at a time, bucket locks can't
+  // be taken in a cycle.
+  struct spinlock evictlock;
   struct buf buf[NBUF];
+  struct bufpage *pages;  // grown pages, protected by evictlock
+  int nbuf;               // NBUF plus those in pages
+  int nq[3];              // buffers on each queue, protected by evictlock
+  int nbusy;              // buffers held or dirty, so not to recycle
+
+  // Protects the idle lists; taken after any bucket lock.
+  struct spinlock idlelock;
+  struct {
+    struct buf *head;     // newest
+    struct buf *tail;     // next to recycle
+  } idle[3];              // for each queue
+
+  uint64 nhit;    // bread()s found valid in the cache
+  uint64 nmiss;   // blocks read from the disk, ahead of time or not
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+  // Each bucket is a list of buffers through next.
+  struct {
+    struct spinlock lock;
+    struct buf *head;
+  } bucket[NBUCKET];
 } bcache;
 
+// Blocks A1 recycled lately, the last nbuf of them, in a ring;
+// hashed like the buffers. Protected by bcache.evictlock.
+struct {
+  struct {
+    uint dev;
+    uint blockno;
+    uint64 seq;   // when it was added
+    int next;     // next in the same hash chain, or -1
+  } e[NGHOST];
+  int head[NBUCKET];
+  uint64 seq;     // entries ever added
+} ghost;
+
+static uint
+bhash(uint dev, uint blockno)
+{
+  return (dev * 31 + blockno) % NBUCKET;
+}
+
+// Put b at the head of its queue's idle list.
+// Caller must hold bcache.idlelock.
+static void
+idlelink(struct buf *b)
+{
+  b->newer = 0;
+  b->older = bcache.idle[b->queue].head;
+  if(b->older)
+    b->older->newer = b;
+  else
+    bcache.idle[b->queue].tail = b;
+  bcache.idle[b->queue].head = b;
+  b->listed = 1;
+}
+
+// Take b off its queue's idle list.
+// Caller must hold bcache.idlelock.
+static void
+idleunlink(struct buf *b)
+{
+  if(b->newer)
+    b->newer->older = b->older;
+  else
+    bcache.idle[b->queue].head = b->older;
+  if(b->older)
+    b->older->newer = b->newer;
+  else
+    bcache.idle[b->queue].tail = b->newer;
+  b->listed = 0;
+}
+
 void
 binit(void)
 {
   struct buf *b;
+  int i;
 
-  initlock(&bcache.lock, "bcache");
+  initlock(&bcache.evictlock, "bcache");
+  initlock(&bcache.idlelock, "bcache.idle");
+  bcache.nbuf = NBUF;
+  bcache.nq[QNONE] = NBUF;
+  for(i = 0; i < NBUCKET; i++)
+    ghost.head[i] = -1;
+  for(i = 0; i < NBUCKET; i++)
+    initlock(&bcache.bucket[i].lock, "bcache.bucket");
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  // Spread the buffers over the buckets; recycling moves them.
+  for(b = bcache.buf, i = 0; b < bcache.buf+NBUF; b++, i++){
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->next = bcache.bucket[i % NBUCKET].head;
+    bcache.bucket[i % NBUCKET].head = b;
+    idlelink(b);
   }
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
-static struct buf*
-bget(uint dev, uint blockno)
+// Add a freshly allocated page of buffers to the cache, in the
+// bucket of block (0, 0), where bget() finds them to recycle.
+// Caller must hold bcache.evictlock.
+static void
+bgrow(struct bufpage *pg)
 {
   struct buf *b;
+  int h = bhash(0, 0);
 
-  acquire(&bcache.lock);
+  memset(pg, 0, sizeof(*pg));
+  pg->next = bcache.pages;
+  bcache.pages = pg;
+  bcache.nbuf += NPAGEBUF;
+  bcache.nq[QNONE] += NPAGEBUF;
+  acquire(&bcache.bucket[h].lock);
+  acquire(&bcache.idlelock);
+  for(b = pg->buf; b < pg->buf+NPAGEBUF; b++){
+    initsleeplock(&b->lock, "buffer");
+    b->next = bcache.bucket[h].head;
+    bcache.bucket[h].head = b;
+    idlelink(b);
+  }
+  release(&bcache.idlelock);
+  release(&bcache.bucket[h].lock);
+}
 
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+// Is b held or dirty?
+#define BUSY(b) ((b)->refcnt > 0 || (b)->dirty)
+
+// Count b in or out of bcache.nbusy if it has become busy or
+// stopped being busy, and put it on its idle list in the latter
+// case; wasbusy is BUSY(b) before the change.
+// Caller must hold b's bucket lock.
+static void
+bbusy(struct buf *b, int wasbusy)
+{
+  if(BUSY(b) && !wasbusy){
+    __sync_fetch_and_add(&bcache.nbusy, 1);
+  } else if(!BUSY(b) && wasbusy){
+    __sync_fetch_and_sub(&bcache.nbusy, 1);
+    acquire(&bcache.idlelock);
+    if(b->listed && b->queue == QAM)
+      idleunlink(b);
+    if(!b->listed)
+      idlelink(b);
+    release(&bcache.idlelock);
+  }
+}
+
+// Find the block in bucket h and take a reference to it.
+// Caller must hold bcache.bucket[h].lock.
+static struct buf*
+bfind(int h, uint dev, uint blockno)
+{
+  struct buf *b;
+  int was;
+
+  for(b = bcache.bucket[h].head; b; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
+      was = BUSY(b);
       b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+      bbusy(b, was);
       return b;
     }
   }
+  return 0;
+}
+
+// Remember that A1 recycled the buffer of a block.
+static void
+ghostadd(uint dev, uint blockno)
+{
+  int i = ghost.seq % NGHOST, *ip;
+
+  if(ghost.seq >= NGHOST){
+    // take the oldest entry out of its chain.
+    ip = &ghost.head[bhash(ghost.e[i].dev, ghost.e[i].blockno)];
+    while(*ip != i)
+      ip = &ghost.e[*ip].next;
+    *ip = ghost.e[i].next;
+  }
+  ghost.e[i].dev = dev;
+  ghost.e[i].blockno = blockno;
+  ghost.e[i].seq = ghost.seq++;
+  ghost.e[i].next = ghost.head[bhash(dev, blockno)];
+  ghost.head[bhash(dev, blockno)] = i;
+}
+
+// Did A1 recycle the block lately?
+static int
+ghostfind(uint dev, uint blockno)
+{
+  int i;
+
+  for(i = ghost.head[bhash(dev, blockno)]; i >= 0; i = ghost.e[i].next)
+    if(ghost.e[i].dev == dev && ghost.e[i].blockno == blockno)
+      return ghost.seq - ghost.e[i].seq <= bcache.nbuf;
+  return 0;
+}
+
+// Take the unused buffer on queue q that is next to recycle off
+// q's idle list, keeping the lock of its bucket, which is returned
+// in *vh. Caller must hold bcache.evictlock and
+// bcache.bucket[h].lock. Returns 0 if every buffer on q is in use.
+static struct buf*
+bvictim(int h, int q, int *vh)
+{
+  struct buf *b;
+
+  for(;;){
+    acquire(&bcache.idlelock);
+    b = bcache.idle[q].tail;
+    release(&bcache.idlelock);
+    if(b == 0)
+      return 0;
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+    // Only a recycler changes b's block, so its bucket stays put.
+    *vh = bhash(b->dev, b->blockno);
+    if(*vh != h)
+      acquire(&bcache.bucket[*vh].lock);
+    acquire(&bcache.idlelock);
+    if(b->listed)
+      idleunlink(b);
+    release(&bcache.idlelock);
+    if(!BUSY(b))
       return b;
-    }
+
+    // Taken since it went on the list; bbusy() puts it back
+    // when it's unused again.
+    if(*vh != h)
+      release(&bcache.bucket[*vh].lock);
   }
-  panic("bget: no buffers");
 }
 
-// Return a locked buf with the contents of the indicated block.
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer; or 0 if the block
+// isn't cached and every buffer is in use.
+static struct buf*
+btryget(uint dev, uint blockno)
+{
+  struct buf *b, *victim, **bp;
+  struct bufpage *pg;
+  int h = bhash(dev, blockno), q, vh;
+
+  // Is the block already cached?
+  acquire(&bcache.bucket[h].lock);
+  if((b = bfind(h, dev, blockno)) != 0){
+    release(&bcache.bucket[h].lock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  release(&bcache.bucket[h].lock);
+
+  // Not cached. While memory is to spare, grow the cache rather
+  // than recycle a buffer. Allocate before taking bcache locks,
+  // since kalloc() may call breclaim().
+  pg = 0;
+  if(__atomic_load_n(&bcache.nbuf, __ATOMIC_RELAXED) + NPAGEBUF <= NBUFMAX &&
+     kfreecount() > BUFMINFREE)
+    pg = kalloc();
+
+  // Become the one recycler, then look again in case another
+  // recycler brought the block in meanwhile.
+  acquire(&bcache.evictlock);
+  if(pg)
+    bgrow(pg);
+  acquire(&bcache.bucket[h].lock);
+  if((b = bfind(h, dev, blockno)) != 0){
+    release(&bcache.bucket[h].lock);
+    release(&bcache.evictlock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+
+  // Recycle a buffer that has never held a block, or else one
+  // from A1 or Am as 2Q says, or else from the other.
+  victim = 0;
+  if(bcache.nq[QNONE] > 0)
+    victim = bvictim(h, QNONE, &vh);
+  if(victim == 0){
+    q = bcache.nq[QA1] > bcache.nbuf / 4 ? QA1 : QAM;
+    if((victim = bvictim(h, q, &vh)) == 0)
+      victim = bvictim(h, q == QA1 ? QAM : QA1, &vh);
+  }
+  if(victim == 0){
+    release(&bcache.bucket[h].lock);
+    release(&bcache.evictlock);
+    return 0;
+  }
+  if(victim->queue == QA1)
+    ghostadd(victim->dev, victim->blockno);
+  bcache.nq[victim->queue]--;
+  victim->queue = ghostfind(dev, blockno) ? QAM : QA1;
+  bcache.nq[victim->queue]++;
+
+  // Move it to bucket h.
+  if(vh != h){
+    for(bp = &bcache.bucket[vh].head; *bp != victim; bp = &(*bp)->next)
+      ;
+    *bp = victim->next;
+    release(&bcache.bucket[vh].lock);
+    victim->next = bcache.bucket[h].head;
+    bcache.bucket[h].head = victim;
+  }
+  victim->dev = dev;
+  victim->blockno = blockno;
+  victim->valid = 0;
+  victim->refcnt = 1;
+  bbusy(victim, 0);
+  victim->lastuse = r_time();  // A1's order
+  release(&bcache.bucket[h].lock);
+  release(&bcache.evictlock);
+  acquiresleep(&victim->lock);
+  return victim;
+}
+
+// btryget(), for those who can't do without the block.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  if((b = btryget(dev, blockno)) == 0)
+    panic("bget: no buffers");
+  return b;
+}
+
+// Return a locked buf for the indicated block, and start reading
+// it from disk if it isn't cached, without waiting for the disk.
+// Call bwait() before looking at b->data.
 struct buf*
-bread(uint dev, uint blockno)
+bread_async(uint dev, uint blockno)
 {
   struct buf *b;
 
+  struct proc *p;
+
   b = bget(dev, blockno);
   if(!b->valid) {
-    virtio_disk_rw(b, 0);
-    b->valid = 1;
+    iostart(b, 0, 0);
+    b->valid = 1;  // once bwait() returns
+    if((p = myproc()) != 0)
+      p->ru.inblock++;
+    __sync_fetch_and_add(&bcache.nmiss, 1);
+  } else {
+    if((p = myproc()) != 0)
+      p->ru.hitblock++;
+    __sync_fetch_and_add(&bcache.nhit, 1);
   }
   return b;
 }
 
-// Write b's contents to disk.  Must be locked.
+// Return a locked buf with the contents of the indicated block.
+struct buf*
+bread(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bread_async(dev, blockno);
+  bwait(b);
+  return b;
+}
+
+// Start writing b's contents to disk, without waiting for the
+// disk. Must be locked. Call bwait() before changing b->data or
+// releasing b.
 void
-bwrite(struct buf *b)
+bwrite_async(struct buf *b)
 {
+  struct proc *p;
+
   if(!holdingsleep(&b->lock))
     panic("bwrite");
-  virtio_disk_rw(b, 1);
+  iostart(b, 1, 0);
+  if((p = myproc()) != 0)
+    p->ru.oublock++;
+}
+
+// Write b's contents to disk.  Must be locked.
+void
+bwrite(struct buf *b)
+{
+  bwrite_async(b);
+  bwait(b);
+}
+
+// Wait for the disk to finish the read or write that
+// bread_async() or bwrite_async() started on b.
+void
+bwait(struct buf *b)
+{
+  iowait(b);
+}
+
+// Make the writes the disk has finished durable. The disk may
+// keep them in a volatile cache until then, and write them out
+// in any order, so the log flushes wherever one write must not
+// reach the disk before another.
+void
+bflush(void)
+{
+  virtio_disk_flush();
+}
+
+// Return in bp[0..n-1] locked bufs with the contents of the n
+// blocks from blockno on. The ones that aren't cached go to the
+// disk together, so runs of them are read by one request.
+void
+bread_range(uint dev, uint blockno, int n, struct buf **bp)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    bp[i] = bread_async(dev, blockno + i);
+  for(i = 0; i < n; i++)
+    bwait(bp[i]);
+}
+
+// Write the n locked bufs in bp to disk, and wait for all of
+// them; those whose blocks follow one another on disk go in
+// one request. Does not release them.
+void
+bwrite_range(struct buf **bp, int n)
+{
+  int i;
+
+  for(i = 0; i < n; i++)
+    bwrite_async(bp[i]);
+  for(i = 0; i < n; i++)
+    bwait(bp[i]);
+}
+
+// Drop a reference to b.
+// Note when it was last used, if on Am, for breclaim().
+static void
+bput(struct buf *b)
+{
+  int h;
+
+  // b can't move to another bucket while we hold a reference.
+  h = bhash(b->dev, b->blockno);
+  acquire(&bcache.bucket[h].lock);
+  b->refcnt--;
+  if (b->refcnt == 0 && b->queue == QAM) {
+    // no one is waiting for it.
+    b->lastuse = r_time();
+  }
+  bbusy(b, 1);
+  release(&bcache.bucket[h].lock);
+}
+
+// Start reading a block into the cache without waiting for it,
+// unless it's there already. The buffer stays locked until the
+// read is done, so a bread() of the block meanwhile waits for it.
+// The read may sit in the I/O scheduler's queue until the caller
+// calls iodispatch(). Returns -1 if the queue is full or the
+// cache is short of unused buffers.
+int
+breadahead(uint dev, uint blockno)
+{
+  struct buf *b;
+  int h = bhash(dev, blockno);
+
+  // Don't wait for the lock of a buffer that's already here.
+  acquire(&bcache.bucket[h].lock);
+  for(b = bcache.bucket[h].head; b; b = b->next)
+    if(b->dev == dev && b->blockno == blockno)
+      break;
+  release(&bcache.bucket[h].lock);
+  if(b)
+    return 0;
+
+  // Read-ahead is a guess, so leave half the cache's floor to
+  // those who need buffers, and never wait for one or panic.
+  if(__atomic_load_n(&bcache.nbuf, __ATOMIC_RELAXED) -
+     __atomic_load_n(&bcache.nbusy, __ATOMIC_RELAXED) <= NBUF / 2)
+    return -1;
+  if((b = btryget(dev, blockno)) == 0)
+    return -1;
+  if(b->valid){
+    brelse(b);
+    return 0;
+  }
+  b->async = 1;
+  if(iostart(b, 0, 1) < 0){
+    b->async = 0;
+    brelse(b);
+    return -1;
+  }
+  return 0;
+}
+
+// Called by virtio_disk_intr() when a breadahead() is done.
+void
+breaddone(struct buf *b)
+{
+  b->valid = 1;
+  __sync_fetch_and_add(&bcache.nmiss, 1);
+  releasesleep(&b->lock);
+  bput(b);
 }
 
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
 void
 brelse(struct buf *b)
 {
@@ -120,34 +583,134 @@ brelse(struct buf *b)
     panic("brelse");
 
   releasesleep(&b->lock);
+  bput(b);
+}
 
-  acquire(&bcache.lock);
-  b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+// Note that b, which the caller holds, is newer than its block on
+// disk, so it must stay in the cache until written back.
+void
+bdirty(struct buf *b)
+{
+  int h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
+  b->dirty = 1;
+  bbusy(b, 1);
+  release(&bcache.bucket[h].lock);
+}
+
+// Note that b's block on disk is as new as b, or as new as b
+// was when last made dirty.
+void
+bclean(struct buf *b)
+{
+  int h = bhash(b->dev, b->blockno);
+
+  int was;
+
+  acquire(&bcache.bucket[h].lock);
+  was = BUSY(b);
+  b->dirty = 0;
+  bbusy(b, was);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  int h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
   b->refcnt++;
-  release(&bcache.lock);
+  bbusy(b, 1);
+  release(&bcache.bucket[h].lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  int h = bhash(b->dev, b->blockno);
+
+  acquire(&bcache.bucket[h].lock);
   b->refcnt--;
-  release(&bcache.lock);
+  bbusy(b, 1);
+  release(&bcache.bucket[h].lock);
 }
 
 
+// Give pages of unused buffers back to the page allocator, those
+// least recently used first. kalloc() calls this when it runs out.
+// Returns the number of pages freed.
+int
+breclaim(void)
+{
+  struct bufpage *pg, **pp, *victim[BRECLAIM];
+  uint64 age[BRECLAIM], last;
+  struct buf *b, **bp;
+  int i, j, n, h, busy;
+
+  acquire(&bcache.evictlock);
+  for(i = 0; i < NBUCKET; i++)
+    acquire(&bcache.bucket[i].lock);
+  acquire(&bcache.idlelock);
+
+  // Pick the unused pages whose newest buffer is oldest.
+  n = 0;
+  for(pg = bcache.pages; pg; pg = pg->next){
+    busy = 0;
+    last = 0;
+    for(b = pg->buf; b < pg->buf+NPAGEBUF; b++){
+      if(b->refcnt || b->dirty)
+        busy = 1;
+      if(b->lastuse > last)
+        last = b->lastuse;
+    }
+    if(busy || (n == BRECLAIM && last >= age[n-1]))
+      continue;
+    if(n < BRECLAIM)
+      n++;
+    for(j = n-1; j > 0 && age[j-1] > last; j--){
+      victim[j] = victim[j-1];
+      age[j] = age[j-1];
+    }
+    victim[j] = pg;
+    age[j] = last;
+  }
+
+  // Unlink them from the page list and their buffers' buckets.
+  for(i = 0; i < n; i++){
+    for(pp = &bcache.pages; *pp != victim[i]; pp = &(*pp)->next)
+      ;
+    *pp = victim[i]->next;
+    for(b = victim[i]->buf; b < victim[i]->buf+NPAGEBUF; b++){
+      h = bhash(b->dev, b->blockno);
+      for(bp = &bcache.bucket[h].head; *bp != b; bp = &(*bp)->next)
+        ;
+      *bp = b->next;
+      if(b->listed)
+        idleunlink(b);
+      bcache.nq[b->queue]--;
+    }
+    bcache.nbuf -= NPAGEBUF;
+  }
+
+  release(&bcache.idlelock);
+  for(i = 0; i < NBUCKET; i++)
+    release(&bcache.bucket[i].lock);
+  release(&bcache.evictlock);
+
+  // freesleeplock() takes the lock list's lock.
+  for(i = 0; i < n; i++){
+    for(b = victim[i]->buf; b < victim[i]->buf+NPAGEBUF; b++)
+      freesleeplock(&b->lock);
+    kfree(victim[i]);
+  }
+  return n;
+}
+
+// Report the cache's size in buffers and its hits and misses.
+void
+bstat(uint64 *nbuf, uint64 *nhit, uint64 *nmiss)
+{
+  *nbuf = __atomic_load_n(&bcache.nbuf, __ATOMIC_RELAXED);
+  *nhit = __atomic_load_n(&bcache.nhit, __ATOMIC_RELAXED);
+  *nmiss = __atomic_load_n(&bcache.nmiss, __ATOMIC_RELAXED);
+}
@@ -5,8 +5,16 @@ struct buf {
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
+  uint64 lastuse;   // rdtime when read in (A1) or refcnt last fell to 0 (Am)
+  int queue;        // 2Q queue, see bio.c
+  int listed;       // on its queue's idle list
+  struct buf *newer; // idle list, toward the head
+  struct buf *older; // idle list, toward the tail
+  int dirty;        // committed but not yet installed; can't be recycled
+  int write;        // iosched: to be written, not read
+  int async;        // breaddone() it when read in; see breadahead
+  struct buf *qnext; // iosched queue, then the rest of its disk request
+  struct buf *next; // next in the same hash bucket
   uchar data[BSIZE];
 };
 
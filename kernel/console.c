@@ -76,10 +76,11 @@ consolewrite(int user_src, uint64 src, int n)
 // user read()s from the console go here.
 // copy (up to) a whole input line to dst.
 // user_dist indicates whether dst is a user
-// or kernel address.
+// or kernel address. the console has no
+// offsets, so off is ignored.
 //
 int
-consoleread(int user_dst, uint64 dst, int n)
+consoleread(int user_dst, uint64 dst, int n, uint off)
 {
   uint target;
   int c;
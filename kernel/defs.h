@@ -2,20 +2,35 @@ struct buf;
 struct context;
 struct file;
 struct inode;
+struct lockstat;
 struct pipe;
 struct proc;
+struct readahead;
 struct spinlock;
 struct sleeplock;
+struct rwsleeplock;
 struct stat;
 struct superblock;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bread_async(uint, uint);
+void            bwrite_async(struct buf*);
+void            bwait(struct buf*);
+void            bflush(void);
+void            bread_range(uint, uint, int, struct buf**);
+void            bwrite_range(struct buf**, int);
+int             breadahead(uint, uint);
+void            breaddone(struct buf*);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            bdirty(struct buf*);
+void            bclean(struct buf*);
+int             breclaim(void);
+void            bstat(uint64*, uint64*, uint64*);
 
 // console.c
 void            consoleinit(void);
@@ -42,14 +57,17 @@ struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilock_shared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
+void            iunlock_shared(struct inode*);
 void            iunlockput(struct inode*);
 void            iupdate(struct inode*);
 int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+void            ireadahead(struct inode*, struct readahead*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -59,15 +77,29 @@ void            ramdiskinit(void);
 void            ramdiskintr(void);
 void            ramdiskrw(struct buf*);
 
+// futex.c
+void            futexinit(void);
+int             futexwait(uint64, int);
+int             futexwake(uint64, int);
+
+// iosched.c
+void            ioinit(void);
+int             iostart(struct buf*, int, int);
+void            iodispatch(void);
+void            iowait(struct buf*);
+void            iostat(uint64*, uint64*);
+
 // kalloc.c
 void*           kalloc(void);
 void            kfree(void *);
 void            kinit(void);
 uint64          getfreeMemorySize();
+int             kfreecount(void);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
+int             logcrash(int);
 void            begin_op(void);
 void            end_op(void);
 
@@ -99,12 +131,27 @@ void            sched(void);
 void            setproc(struct proc*);
 void            sleep(void*, struct spinlock*);
 void            userinit(void);
+int             kthread(void (*)(void *), void *, char *);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeupproc(struct proc*, void*);
+void            wakeuphandoff(void*);
+void            sleephandoff(void*, struct spinlock*);
 void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             procreclaim(void);
+int             setaffinity(int, uint64);
+int             getaffinity(int, uint64*);
+int             clone(uint64, uint64, uint64);
+int             join(int, uint64);
+int             getrusage(int, uint64);
+int             pstat(uint64, int);
+int             procrunning(int, int);
+void            kickrt(uint64);
+int             rtsched(int, int);
+int             rtwait(void);
 uint64          getProcessUnusedCount();
 
 // swtch.S
@@ -114,15 +161,34 @@ void            swtch(struct context*, struct context*);
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            freelock(struct spinlock*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
+void            lockstatinit(struct lockstat*, char*, int);
+void            lockstatfree(struct lockstat*);
+void            lockstatreset(void);
+int             statslock(char*, int);
 
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
+void            freesleeplock(struct sleeplock*);
+void            initrwsleeplock(struct rwsleeplock*, char*);
+void            acquirerwsleep(struct rwsleeplock*);
+void            releaserwsleep(struct rwsleeplock*);
+void            acquirerwsleep_shared(struct rwsleeplock*);
+void            releaserwsleep_shared(struct rwsleeplock*);
+int             holdingrwsleep(struct rwsleeplock*);
+int             heldrwsleep(struct rwsleeplock*);
+
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
+// stats.c
+void            statsinit(void);
 
 // string.c
 int             memcmp(const void*, const void*, uint);
@@ -145,8 +211,14 @@ void            syscall();
 extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
-extern struct spinlock tickslock;
 void            usertrapret(void);
+void            tickupdate(void);
+uint            tickcount(void);
+int             sleepuntil(uint);
+uint64          timernext(void);
+void            timerset(uint64);
+void            timerkick(int);
+uint64          alarmreturn(void);
 
 // uart.c
 void            uartinit(void);
@@ -160,6 +232,9 @@ void            kvminit(void);
 void            kvminithart(void);
 uint64          kvmpa(uint64);
 void            kvmmap(uint64, uint64, uint64, int);
+void            kvmprealloc(uint64, uint64);
+void            kvmmapkstack(uint64, uint64);
+void            kvmunmapkstack(uint64);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 void            uvminit(pagetable_t, uchar *, uint);
@@ -182,7 +257,10 @@ void            plic_complete(int);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
+void            virtio_disk_submit(struct buf *, int, int);
+void            virtio_disk_wait(struct buf *);
+int             virtio_disk_poll(int);
+void            virtio_disk_flush(void);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -3,11 +3,14 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "fs.h"
+#include "file.h"
 
-static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, uint offset, uint sz);
+static int loadseg(pde_t *pgdir, uint64 addr, struct inode *ip, struct readahead *ra, uint offset, uint sz);
 
 int
 exec(char *path, char **argv)
@@ -18,16 +21,22 @@ exec(char *path, char **argv)
   struct elfhdr elf;
   struct inode *ip;
   struct proghdr ph;
+  struct readahead ra;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
+  // the other threads would be left without an address space.
+  if(p->leader != p || p->nthreads > 0)
+    return -1;
+
   begin_op();
 
   if((ip = namei(path)) == 0){
     end_op();
     return -1;
   }
-  ilock(ip);
+  // only reads ip, so other execs of the same file can run alongside.
+  ilock_shared(ip);
 
   // Check ELF header
   if(readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
@@ -39,6 +48,7 @@ exec(char *path, char **argv)
     goto bad;
 
   // Load program into memory.
+  memset(&ra, 0, sizeof(ra));
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -54,10 +64,11 @@ exec(char *path, char **argv)
     sz = sz1;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(loadseg(pagetable, ph.vaddr, ip, &ra, ph.off, ph.filesz) < 0)
       goto bad;
   }
-  iunlockput(ip);
+  iunlock_shared(ip);
+  iput(ip);
   end_op();
   ip = 0;
 
@@ -114,6 +125,8 @@ exec(char *path, char **argv)
   p->sz = sz;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
+  p->alarm_interval = 0; // the handler is gone
+  p->alarm_frame = 0;
   proc_freepagetable(oldpagetable, oldsz);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
@@ -122,7 +135,8 @@ exec(char *path, char **argv)
   if(pagetable)
     proc_freepagetable(pagetable, sz);
   if(ip){
-    iunlockput(ip);
+    iunlock_shared(ip);
+    iput(ip);
     end_op();
   }
   return -1;
@@ -131,9 +145,10 @@ exec(char *path, char **argv)
 // Load a program segment into pagetable at virtual address va.
 // va must be page-aligned
 // and the pages from va to va+sz must already be mapped.
+// Reads ahead as ra says.
 // Returns 0 on success, -1 on failure.
 static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
+loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, struct readahead *ra, uint offset, uint sz)
 {
   uint i, n;
   uint64 pa;
@@ -149,6 +164,7 @@ loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz
       n = sz - i;
     else
       n = PGSIZE;
+    ireadahead(ip, ra, offset+i, n);
     if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
       return -1;
   }
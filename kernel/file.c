@@ -22,7 +22,11 @@ struct {
 void
 fileinit(void)
 {
+  int i;
+
   initlock(&ftable.lock, "ftable");
+  for(i = 0; i < NFILE; i++)
+    initsleeplock(&ftable.file[i].offlock, "file off");
 }
 
 // Allocate a file structure.
@@ -35,6 +39,7 @@ filealloc(void)
   for(f = ftable.file; f < ftable.file + NFILE; f++){
     if(f->ref == 0){
       f->ref = 1;
+      memset(&f->ra, 0, sizeof(f->ra));
       release(&ftable.lock);
       return f;
     }
@@ -116,12 +121,18 @@ fileread(struct file *f, uint64 addr, int n)
   } else if(f->type == FD_DEVICE){
     if(f->major < 0 || f->major >= NDEV || !devsw[f->major].read)
       return -1;
-    r = devsw[f->major].read(1, addr, n);
+    if((r = devsw[f->major].read(1, addr, n, f->off)) > 0)
+      f->off += r;
   } else if(f->type == FD_INODE){
-    ilock(f->ip);
+    // readers of the same inode through different files run in
+    // parallel; off still needs one read() at a time per file.
+    acquiresleep(&f->offlock);
+    ilock_shared(f->ip);
+    ireadahead(f->ip, &f->ra, f->off, n);
     if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
       f->off += r;
-    iunlock(f->ip);
+    iunlock_shared(f->ip);
+    releasesleep(&f->offlock);
   } else {
     panic("fileread");
   }
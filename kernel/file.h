@@ -1,3 +1,10 @@
+// How a file has been read, for read-ahead.
+struct readahead {
+  uint next;   // block a read carrying on from the last would start at
+  uint win;    // blocks to read ahead; 0 if reads don't look sequential
+  uint ahead;  // first block not yet read ahead
+};
+
 struct file {
   enum { FD_NONE, FD_PIPE, FD_INODE, FD_DEVICE } type;
   int ref; // reference count
@@ -5,7 +12,9 @@ struct file {
   char writable;
   struct pipe *pipe; // FD_PIPE
   struct inode *ip;  // FD_INODE and FD_DEVICE
-  uint off;          // FD_INODE
+  uint off;          // FD_INODE and FD_DEVICE
+  struct sleeplock offlock; // FD_INODE: serializes read()s that move off
+  struct readahead ra;      // FD_INODE: protected by offlock
   short major;       // FD_DEVICE
 };
 
@@ -18,7 +27,7 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
-  struct sleeplock lock; // protects everything below here
+  struct rwsleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
   short type;         // copy of disk inode
@@ -30,11 +39,13 @@ struct inode {
 };
 
 // map major device number to device functions.
+// read() is passed the file's offset.
 struct devsw {
-  int (*read)(int, uint64, int);
+  int (*read)(int, uint64, int, uint);
   int (*write)(int, uint64, int);
 };
 
 extern struct devsw devsw[];
 
 #define CONSOLE 1
+#define STATS   2
@@ -15,8 +15,8 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
-#include "proc.h"
 #include "sleeplock.h"
+#include "proc.h"
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
@@ -170,6 +170,10 @@ bfree(int dev, uint b)
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
 // dev, and inum.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
+// ip->lock is a reader-writer lock: operations that only read
+// the inode and its contents (read(), directory lookups in
+// namex(), exec) hold it shared via ilock_shared(), so they can
+// run in parallel on the same file.
 
 struct {
   struct spinlock lock;
@@ -183,7 +187,7 @@ iinit()
   
   initlock(&icache.lock, "icache");
   for(i = 0; i < NINODE; i++) {
-    initsleeplock(&icache.inode[i].lock, "inode");
+    initrwsleeplock(&icache.inode[i].lock, "inode");
   }
 }
 
@@ -294,7 +298,7 @@ ilock(struct inode *ip)
   if(ip == 0 || ip->ref < 1)
     panic("ilock");
 
-  acquiresleep(&ip->lock);
+  acquirerwsleep(&ip->lock);
 
   if(ip->valid == 0){
     bp = bread(ip->dev, IBLOCK(ip->inum, sb));
@@ -312,14 +316,45 @@ ilock(struct inode *ip)
   }
 }
 
+// Lock the given inode shared, for reading only: the caller
+// must not change ip or its contents. Other shared holders may
+// be reading it at the same time.
+void
+ilock_shared(struct inode *ip)
+{
+  if(ip == 0 || ip->ref < 1)
+    panic("ilock_shared");
+
+  acquirerwsleep_shared(&ip->lock);
+  if(ip->valid == 0){
+    // reading it in from disk changes ip, so needs the lock
+    // exclusively. once valid, ip stays valid while we hold
+    // a reference.
+    releaserwsleep_shared(&ip->lock);
+    ilock(ip);
+    iunlock(ip);
+    acquirerwsleep_shared(&ip->lock);
+  }
+}
+
 // Unlock the given inode.
 void
 iunlock(struct inode *ip)
 {
-  if(ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1)
+  if(ip == 0 || !holdingrwsleep(&ip->lock) || ip->ref < 1)
     panic("iunlock");
 
-  releasesleep(&ip->lock);
+  releaserwsleep(&ip->lock);
+}
+
+// Unlock an inode locked with ilock_shared().
+void
+iunlock_shared(struct inode *ip)
+{
+  if(ip == 0 || !heldrwsleep(&ip->lock) || ip->ref < 1)
+    panic("iunlock_shared");
+
+  releaserwsleep_shared(&ip->lock);
 }
 
 // Drop a reference to an in-memory inode.
@@ -339,7 +374,7 @@ iput(struct inode *ip)
 
     // ip->ref == 1 means no other process can have ip locked,
     // so this acquiresleep() won't block (or deadlock).
-    acquiresleep(&ip->lock);
+    acquirerwsleep(&ip->lock);
 
     release(&icache.lock);
 
@@ -348,7 +383,7 @@ iput(struct inode *ip)
     iupdate(ip);
     ip->valid = 0;
 
-    releasesleep(&ip->lock);
+    releaserwsleep(&ip->lock);
 
     acquire(&icache.lock);
   }
@@ -448,6 +483,60 @@ stati(struct inode *ip, struct stat *st)
   st->size = ip->size;
 }
 
+// Read-ahead for a reader of ip, whose reads so far are summed
+// up in ra, that is about to read n bytes at off. If the read
+// carries on from the last one, start reading the blocks after
+// it into the cache, doubling the window with each new block read
+// in sequence, up to READAHEAD blocks; any other read closes it.
+// Caller must hold ip->lock, shared or not.
+void
+ireadahead(struct inode *ip, struct readahead *ra, uint off, uint n)
+{
+  uint bn, last, end;
+
+  if(n == 0 || off >= ip->size)
+    return;
+  if(off + n > ip->size || off + n < off)
+    n = ip->size - off;
+  bn = off / BSIZE;
+  last = (off + n - 1) / BSIZE;
+
+  if(bn == ra->next){
+    ra->win = min(ra->win ? ra->win * 2 : 2, READAHEAD);
+  } else if(bn + 1 != ra->next){
+    // not a read of the rest of the last block either.
+    ra->win = 0;
+    ra->ahead = 0;
+  }
+  ra->next = last + 1;
+  if(ra->win == 0)
+    return;
+
+  end = min(last + ra->win, (ip->size - 1) / BSIZE);
+  if(ra->ahead <= last)
+    ra->ahead = last + 1;
+  for(; ra->ahead <= end; ra->ahead++)
+    if(breadahead(ip->dev, bmap(ip, ra->ahead)) < 0)
+      break;  // disk queue full or cache short; try again next read
+  iodispatch();
+}
+
+// Map the file blocks of the n bytes at off, from the first on,
+// for as long as they are consecutive on disk, at most MAXSEG;
+// set *addr to the first's disk address and return how many.
+static int
+bmaprun(struct inode *ip, uint off, uint n, uint *addr)
+{
+  uint bn = off / BSIZE, last = (off + n - 1) / BSIZE;
+  int nb;
+
+  *addr = bmap(ip, bn);
+  for(nb = 1; nb < MAXSEG && bn + nb <= last; nb++)
+    if(bmap(ip, bn + nb) != *addr + nb)
+      break;
+  return nb;
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -455,22 +544,29 @@ stati(struct inode *ip, struct stat *st)
 int
 readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint tot, m, addr;
+  struct buf *bp[MAXSEG];
+  int i, nb, err = 0;
 
   if(off > ip->size || off + n < off)
     return 0;
   if(off + n > ip->size)
     n = ip->size - off;
 
-  for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
-      brelse(bp);
-      break;
+  for(tot=0; tot<n && !err; ){
+    nb = bmaprun(ip, off, n - tot, &addr);
+    bread_range(ip->dev, addr, nb, bp);
+    for(i = 0; i < nb; i++){
+      m = min(n - tot, BSIZE - off%BSIZE);
+      if(!err && either_copyout(user_dst, dst, bp[i]->data + (off % BSIZE), m) == -1)
+        err = 1;
+      if(!err){
+        tot += m;
+        off += m;
+        dst += m;
+      }
+      brelse(bp[i]);
     }
-    brelse(bp);
   }
   return tot;
 }
@@ -482,23 +578,30 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 int
 writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
-  uint tot, m;
-  struct buf *bp;
+  uint tot, m, addr;
+  struct buf *bp[MAXSEG];
+  int i, nb, err = 0;
 
   if(off > ip->size || off + n < off)
     return -1;
   if(off + n > MAXFILE*BSIZE)
     return -1;
 
-  for(tot=0; tot<n; tot+=m, off+=m, src+=m){
-    bp = bread(ip->dev, bmap(ip, off/BSIZE));
-    m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1) {
-      brelse(bp);
-      break;
+  for(tot=0; tot<n && !err; ){
+    nb = bmaprun(ip, off, n - tot, &addr);
+    bread_range(ip->dev, addr, nb, bp);
+    for(i = 0; i < nb; i++){
+      m = min(n - tot, BSIZE - off%BSIZE);
+      if(!err && either_copyin(bp[i]->data + (off % BSIZE), user_src, src, m) == -1)
+        err = 1;
+      if(!err){
+        log_write(bp[i]);
+        tot += m;
+        off += m;
+        src += m;
+      }
+      brelse(bp[i]);
     }
-    log_write(bp);
-    brelse(bp);
   }
 
   if(n > 0){
@@ -629,25 +732,30 @@ namex(char *path, int nameiparent, char *name)
 
   if(*path == '/')
     ip = iget(ROOTDEV, ROOTINO);
-  else
-    ip = idup(myproc()->cwd);
+  else {
+    struct proc *l = myproc()->leader;
+    acquire(&l->filelock);
+    ip = idup(l->cwd);
+    release(&l->filelock);
+  }
 
   while((path = skipelem(path, name)) != 0){
-    ilock(ip);
+    ilock_shared(ip);
     if(ip->type != T_DIR){
-      iunlockput(ip);
+      iunlock_shared(ip);
+      iput(ip);
       return 0;
     }
     if(nameiparent && *path == '\0'){
       // Stop one level early.
-      iunlock(ip);
+      iunlock_shared(ip);
       return ip;
     }
-    if((next = dirlookup(ip, name, 0)) == 0){
-      iunlockput(ip);
+    next = dirlookup(ip, name, 0);
+    iunlock_shared(ip);
+    iput(ip);
+    if(next == 0)
       return 0;
-    }
-    iunlockput(ip);
     ip = next;
   }
   if(nameiparent){
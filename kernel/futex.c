@@ -0,0 +1,118 @@
+//
+// Futexes: let user threads sleep until another thread changes a word
+// of shared memory. A waiter is keyed by the physical address of the
+// word, so every mapping of the same page finds the same queue.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "proc.h"
+
+#define NFUTEX 64   // hash buckets
+
+// lives on the waiting process's kernel stack.
+struct futexwaiter {
+  uint64 key;                 // physical address of the word
+  struct proc *proc;
+  int woken;
+  struct futexwaiter *next;
+};
+
+struct {
+  struct spinlock lock;
+  struct futexwaiter *head;
+} futextab[NFUTEX];
+
+void
+futexinit(void)
+{
+  for(int i = 0; i < NFUTEX; i++)
+    initlock(&futextab[i].lock, "futex");
+}
+
+// the physical address behind the user int at addr, or 0.
+static uint64
+futexkey(uint64 addr)
+{
+  uint64 pa;
+
+  if(addr % sizeof(int) != 0)
+    return 0;
+  if((pa = walkaddr(myproc()->pagetable, PGROUNDDOWN(addr))) == 0)
+    return 0;
+  return pa + (addr - PGROUNDDOWN(addr));
+}
+
+// if the int at user address addr still holds val, sleep until
+// futexwake() on the same word. returns 0 when woken, -1 if the
+// word had changed, addr is bad, or the process was killed.
+int
+futexwait(uint64 addr, int val)
+{
+  struct futexwaiter w, **wp;
+  uint64 key;
+  struct proc *p = myproc();
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+
+  // the bucket lock orders this check against a waker's
+  // change of the word and its call to futexwake().
+  acquire(&futextab[key % NFUTEX].lock);
+  if(*(volatile int*)key != val){
+    release(&futextab[key % NFUTEX].lock);
+    return -1;
+  }
+
+  w.key = key;
+  w.proc = p;
+  w.woken = 0;
+  w.next = futextab[key % NFUTEX].head;
+  futextab[key % NFUTEX].head = &w;
+
+  while(!w.woken && !p->killed)
+    sleep(&w, &futextab[key % NFUTEX].lock);
+
+  if(!w.woken){
+    // killed; take ourselves off the queue.
+    for(wp = &futextab[key % NFUTEX].head; *wp; wp = &(*wp)->next){
+      if(*wp == &w){
+        *wp = w.next;
+        break;
+      }
+    }
+  }
+  release(&futextab[key % NFUTEX].lock);
+  return w.woken ? 0 : -1;
+}
+
+// wake up to n processes waiting on the int at user address addr.
+// returns the number woken, or -1 if addr is bad.
+int
+futexwake(uint64 addr, int n)
+{
+  struct futexwaiter *w, **wp;
+  uint64 key;
+  int woken = 0;
+
+  if((key = futexkey(addr)) == 0)
+    return -1;
+
+  acquire(&futextab[key % NFUTEX].lock);
+  for(wp = &futextab[key % NFUTEX].head; (w = *wp) != 0 && woken < n; ){
+    if(w->key != key){
+      wp = &w->next;
+      continue;
+    }
+    *wp = w->next;
+    w->woken = 1;
+    wakeupproc(w->proc, w);
+    woken++;
+  }
+  release(&futextab[key % NFUTEX].lock);
+  return woken;
+}
@@ -0,0 +1,114 @@
+// Block I/O scheduler.
+//
+// bio.c hands reads and writes of locked buffers to iostart(),
+// which queues them sorted by block number rather than sending
+// each to the disk at once. iodispatch() sends the whole queue
+// to the disk in that order, one sweep of an elevator, and merges
+// each run of consecutive blocks going the same way, up to MAXSEG
+// of them, into a single multi-segment virtio request.
+//
+// The queue is dispatched when anyone waits for a buffer (iowait),
+// when it grows to IOQMAX buffers, and when a caller that queued
+// reads without waiting for them is done (iodispatch). So nothing
+// sits in the queue for long, while a caller that starts a batch
+// of I/O before it waits for any gets the batch merged.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+
+#define IOQMAX 64
+
+struct {
+  struct spinlock lock;
+  struct buf *head;  // queued buffers by block number, through qnext
+  int n;             // how many
+
+  uint64 nreq;       // requests sent to the disk
+  uint64 nmerge;     // buffers that went in another buffer's request
+} io;
+
+void
+ioinit(void)
+{
+  initlock(&io.lock, "iosched");
+}
+
+// Queue locked buffer b to be read from or written to disk.
+// If nowait, return -1 rather than queue b when the queue is
+// full, for I/O that is only worth doing if it's cheap.
+int
+iostart(struct buf *b, int write, int nowait)
+{
+  struct buf **bp;
+  int full;
+
+  acquire(&io.lock);
+  if(nowait && io.n >= IOQMAX){
+    release(&io.lock);
+    return -1;
+  }
+  b->disk = 1;
+  b->write = write;
+  for(bp = &io.head; *bp && (*bp)->blockno < b->blockno; bp = &(*bp)->qnext)
+    ;
+  b->qnext = *bp;
+  *bp = b;
+  full = ++io.n >= IOQMAX;
+  release(&io.lock);
+
+  if(full)
+    iodispatch();
+  return 0;
+}
+
+// Send everything queued to the disk, in block order, merging
+// consecutive blocks going the same way.
+void
+iodispatch(void)
+{
+  struct buf *list, *b, *last;
+  int n;
+
+  acquire(&io.lock);
+  list = io.head;
+  io.head = 0;
+  io.n = 0;
+  release(&io.lock);
+
+  while((b = list) != 0){
+    // take the run of blocks that follow b on disk.
+    n = 1;
+    for(last = b; last->qnext && n < MAXSEG; last = last->qnext, n++){
+      if(last->qnext->dev != b->dev || last->qnext->write != b->write ||
+         last->qnext->blockno != last->blockno + 1)
+        break;
+    }
+    list = last->qnext;
+    last->qnext = 0;
+    virtio_disk_submit(b, n, b->write);
+    __sync_fetch_and_add(&io.nreq, 1);
+    __sync_fetch_and_add(&io.nmerge, n - 1);
+  }
+}
+
+// Wait for the disk to finish reading or writing b.
+void
+iowait(struct buf *b)
+{
+  iodispatch();  // b may be in the queue
+  virtio_disk_wait(b);
+}
+
+// Report the disk requests sent and the buffers merged.
+void
+iostat(uint64 *nreq, uint64 *nmerge)
+{
+  *nreq = __atomic_load_n(&io.nreq, __ATOMIC_RELAXED);
+  *nmerge = __atomic_load_n(&io.nmerge, __ATOMIC_RELAXED);
+}
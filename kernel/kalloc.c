@@ -21,6 +21,7 @@ struct run {
 struct {
   struct spinlock lock;
   struct run *freelist;
+  int nfree;      // pages on freelist
 } kmem;
 
 void
@@ -59,6 +60,7 @@ kfree(void *pa)
   acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
+  kmem.nfree++;
   release(&kmem.lock);
 }
 
@@ -72,15 +74,29 @@ kalloc(void)
 
   acquire(&kmem.lock);
   r = kmem.freelist;
-  if(r)
+  if(r){
     kmem.freelist = r->next;
+    kmem.nfree--;
+  }
   release(&kmem.lock);
 
   if(r)
     memset((char*)r, 5, PGSIZE); // fill with junk
+  else if(procreclaim() > 0)
+    return kalloc();             // free procs gave some back
+  else if(breclaim() > 0)
+    return kalloc();             // so did the buffer cache
   return (void*)r;
 }
 
+// How many pages are free, without taking the lock;
+// only a hint, for deciding whether memory is to spare.
+int
+kfreecount(void)
+{
+  return __atomic_load_n(&kmem.nfree, __ATOMIC_RELAXED);
+}
+
 uint64 getfreeMemorySize(){
   struct run * r;
   uint64 freeMemoryPageCount = 0;
@@ -2,6 +2,7 @@
 #include "riscv.h"
 #include "defs.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "fs.h"
@@ -29,6 +30,18 @@
 //   block C
 //   ...
 // Log appends are synchronous.
+//
+// Installing a committed transaction's blocks to their home
+// locations is not: commit() hands that to the flusher kernel
+// thread, so end_op() only pays for the log writes. The cached
+// copies of the blocks stay dirty, and so in the cache, until
+// installed. The next commit waits for the install to finish
+// before it reuses the log.
+//
+// The disk caches writes, so the log orders them with flushes:
+// the log blocks before the header that commits them, the header
+// before the installs, the installs before the header that
+// erases the log, and that header before the log is reused.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -43,13 +56,29 @@ struct log {
   int size;
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int installing;  // flusher is installing inst.
   int dev;
   struct logheader lh;
+  struct logheader inst;  // committed, being installed
+  int crash;       // crash point armed for the next commit
+  int instcrash;   // crash point of the transaction in inst
 };
 struct log log;
 
+// the flusher writes home blocks through these, rather than the
+// cached copies, which a newer transaction may have changed.
+static struct buf flushbuf[LOGSIZE];
+
+// For crash-recovery tests: power off in the middle of a commit,
+// at one of these points. qemu writes out its disk cache as it
+// exits, so this tests recovery, not the flushes.
+#define CRASH_LOG     1  // log written, header not
+#define CRASH_COMMIT  2  // header written, nothing installed
+#define CRASH_INSTALL 3  // half the blocks installed
+
 static void recover_from_log(void);
 static void commit();
+static void flusher(void *);
 
 void
 initlog(int dev, struct superblock *sb)
@@ -62,22 +91,31 @@ initlog(int dev, struct superblock *sb)
   log.size = sb->nlog;
   log.dev = dev;
   recover_from_log();
+  if (kthread(flusher, 0, "flusher") < 0)
+    panic("initlog: flusher");
 }
 
-// Copy committed blocks from log to their home location
+// Copy committed blocks from log to their home location,
+// when recovering at boot. Reads the log MAXSEG blocks at a
+// time, and writes each batch's home blocks together.
 static void
 install_trans(void)
 {
-  int tail;
+  struct buf *lbuf[MAXSEG], *dbuf[MAXSEG];
+  int tail, i, n;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+  for (tail = 0; tail < log.lh.n; tail += n) {
+    n = log.lh.n - tail < MAXSEG ? log.lh.n - tail : MAXSEG;
+    bread_range(log.dev, log.start+tail+1, n, lbuf); // read log blocks
+    for (i = 0; i < n; i++) {
+      dbuf[i] = bread(log.dev, log.lh.block[tail+i]); // read dst
+      memmove(dbuf[i]->data, lbuf[i]->data, BSIZE);  // copy block to dst
+    }
+    bwrite_range(dbuf, n);  // write dst to disk
+    for (i = 0; i < n; i++) {
+      brelse(lbuf[i]);
+      brelse(dbuf[i]);
+    }
   }
 }
 
@@ -95,18 +133,18 @@ read_head(void)
   brelse(buf);
 }
 
-// Write in-memory log header to disk.
+// Write in-memory log header lh to disk.
 // This is the true point at which the
 // current transaction commits.
 static void
-write_head(void)
+write_head(struct logheader *lh)
 {
   struct buf *buf = bread(log.dev, log.start);
   struct logheader *hb = (struct logheader *) (buf->data);
   int i;
-  hb->n = log.lh.n;
-  for (i = 0; i < log.lh.n; i++) {
-    hb->block[i] = log.lh.block[i];
+  hb->n = lh->n;
+  for (i = 0; i < lh->n; i++) {
+    hb->block[i] = lh->block[i];
   }
   bwrite(buf);
   brelse(buf);
@@ -117,8 +155,46 @@ recover_from_log(void)
 {
   read_head();
   install_trans(); // if committed, copy from log to disk
+  bflush();
   log.lh.n = 0;
-  write_head(); // clear the log
+  write_head(&log.lh); // clear the log
+  bflush();
+}
+
+// Arm a crash at point, one of the CRASH_ points, for the next
+// commit, or disarm with 0, also for a commit that has handed its
+// transaction to the flusher. Only in kernels built with
+// CRASHTEST; fails in others.
+int
+logcrash(int point)
+{
+#ifdef CRASHTEST
+  if (point < 0 || point > CRASH_INSTALL)
+    return -1;
+  acquire(&log.lock);
+  log.crash = point;
+  if (point == 0)
+    log.instcrash = 0;
+  release(&log.lock);
+  return 0;
+#else
+  return -1;
+#endif
+}
+
+// Stop the machine, as a power failure would, if the armed
+// crash point is point.
+static void
+crashat(int armed, int point)
+{
+#ifdef CRASHTEST
+  if (armed != point)
+    return;
+  printf("log: crash at point %d\n", point);
+  *(volatile uint32 *)VIRT_TEST = VIRT_TEST_POWEROFF;
+  for (;;)
+    ;
+#endif
 }
 
 // called at the start of each FS system call.
@@ -174,30 +250,109 @@ end_op(void)
 }
 
 // Copy modified blocks from cache to log.
+// The log is contiguous, so it is read and written as a
+// range, MAXSEG blocks per disk request.
 static void
 write_log(void)
 {
+  struct buf *to[LOGSIZE];
   int tail;
 
+  bread_range(log.dev, log.start+1, log.lh.n, to); // log blocks
   for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
     struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
+    memmove(to[tail]->data, from->data, BSIZE);
+    bdirty(from);  // keeps it cached until the flusher is done
+    bunpin(from);
     brelse(from);
-    brelse(to);
   }
+  bwrite_range(to, log.lh.n);  // write the log
+  for (tail = 0; tail < log.lh.n; tail++)
+    brelse(to[tail]);
 }
 
 static void
 commit()
 {
+  int crash;
+
   if (log.lh.n > 0) {
-    write_log();     // Write modified blocks from cache to log
-    write_head();    // Write header to disk -- the real commit
-    install_trans(); // Now install writes to home locations
+    // the log holds the last transaction until it's installed.
+    acquire(&log.lock);
+    while (log.installing)
+      sleep(&log, &log.lock);
+    crash = log.crash;
+    log.crash = 0;
+    release(&log.lock);
+
+    write_log();          // Write modified blocks from cache to log
+    bflush();             // the log before the header that commits it
+    crashat(crash, CRASH_LOG);
+    write_head(&log.lh);  // Write header to disk -- the real commit
+
+    // Have the flusher install writes to home locations.
+    acquire(&log.lock);
+    log.inst = log.lh;
+    log.instcrash = crash;
+    log.installing = 1;
     log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    wakeup(&log.inst);
+    release(&log.lock);
+  }
+}
+
+// Kernel thread that installs each committed transaction's blocks
+// from the log to their home locations, then erases it from the
+// log.
+static void
+flusher(void *arg)
+{
+  struct logheader empty;
+  struct buf *lbuf[MAXSEG], *dbuf;
+  int tail, i, n;
+
+  empty.n = 0;
+  for (;;) {
+    acquire(&log.lock);
+    while (!log.installing)
+      sleep(&log.inst, &log.lock);
+    release(&log.lock);
+
+    bflush();  // the commit before the installs
+    crashat(log.instcrash, CRASH_COMMIT);
+
+    // start all the writes, then wait for them. reads the log
+    // MAXSEG blocks at a time, as install_trans() does, so as not
+    // to hold more of the cache than NBUF allows for.
+    for (tail = 0; tail < log.inst.n; tail += n) {
+      n = log.inst.n - tail < MAXSEG ? log.inst.n - tail : MAXSEG;
+      bread_range(log.dev, log.start+tail+1, n, lbuf); // read log blocks
+      for (i = 0; i < n; i++) {
+        memmove(flushbuf[tail+i].data, lbuf[i]->data, BSIZE);
+        brelse(lbuf[i]);
+        flushbuf[tail+i].dev = log.dev;
+        flushbuf[tail+i].blockno = log.inst.block[tail+i];
+        iostart(&flushbuf[tail+i], 1, 0);  // write dst to disk
+      }
+    }
+    for (tail = 0; tail < log.inst.n; tail++) {
+      if (log.instcrash == CRASH_INSTALL && tail == log.inst.n / 2) {
+        bflush();  // what is installed so far
+        crashat(log.instcrash, CRASH_INSTALL);
+      }
+      iowait(&flushbuf[tail]);
+      dbuf = bread(log.dev, log.inst.block[tail]);
+      bclean(dbuf);
+      brelse(dbuf);
+    }
+    bflush();  // the installs before the erase
+    write_head(&empty);  // Erase the transaction from the log
+    bflush();  // the erase before the next commit reuses the log
+
+    acquire(&log.lock);
+    log.installing = 0;
+    wakeup(&log);
+    release(&log.lock);
   }
 }
 
@@ -27,7 +27,10 @@ main()
     binit();         // buffer cache
     iinit();         // inode cache
     fileinit();      // file table
+    futexinit();     // futex wait queues
+    statsinit();     // lock statistics device
     virtio_disk_init(); // emulated hard disk
+    ioinit();        // block I/O scheduler
     userinit();      // first user process
     __sync_synchronize();
     started = 1;
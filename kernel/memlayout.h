@@ -4,6 +4,7 @@
 // based on qemu's hw/riscv/virt.c:
 //
 // 00001000 -- boot ROM, provided by qemu
+// 00100000 -- test device, which can power off
 // 02000000 -- CLINT
 // 0C000000 -- PLIC
 // 10000000 -- uart0 
@@ -17,6 +18,11 @@
 // end -- start of kernel page allocation area
 // PHYSTOP -- end RAM used by the kernel
 
+// qemu's test device; writing VIRT_TEST_POWEROFF to it
+// stops the machine.
+#define VIRT_TEST 0x100000L
+#define VIRT_TEST_POWEROFF 0x5555
+
 // qemu puts UART registers here in physical memory.
 #define UART0 0x10000000L
 #define UART0_IRQ 10
@@ -65,3 +71,7 @@
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+// a thread's trapframe, below its group leader's; one
+// page per process-table slot, so they never collide.
+#define TTRAPFRAME(slot) (TRAPFRAME - ((slot)+1)*PGSIZE)
@@ -1,4 +1,4 @@
-#define NPROC 64                   // maximum number of processes
+#define NPROC 1024                 // maximum number of processes
 #define NCPU 8                     // maximum number of CPUs
 #define NOFILE 16                  // open files per process
 #define NFILE 100                  // open files per system
@@ -8,9 +8,20 @@
 #define MAXARG 32                  // max exec arguments
 #define MAXOPBLOCKS 10             // max # of blocks any FS op writes
 #define LOGSIZE (MAXOPBLOCKS * 3)  // max data blocks in on-disk log
-#define NBUF (MAXOPBLOCKS * 3)     // size of disk block cache
-#define FSSIZE 1000                // size of file system in blocks
+#define NBUF (LOGSIZE * 3 + MAXSEG * 4) // disk block cache buffers that are always there; see bio.c
+#define NBUFMAX 6144               // most buffers the disk block cache grows to
+#define BUFMINFREE 1024            // free pages below which the block cache stops growing
+#define FSSIZE 10000               // size of file system in blocks
+#define READAHEAD 32               // most blocks read ahead of a sequential reader
+#define MAXSEG 16                  // most blocks merged into one disk request
+#define DISKPOLL 0                 // rdtime cycles a disk wait polls before sleeping; 0 for interrupts only
 #define MAXPATH 128                // maximum file path name
+#define TICKINTERVAL 1000000       // timer cycles per tick; about 1/10th second in qemu
+#define TICKLESS 1                 // stop the tick on idle harts
+#define SLEEPSPIN 500              // rdtime cycles acquiresleep() may spin on a running holder
+#define TICKETLOCK 1               // fair ticket spinlocks; 0 for plain test-and-set
+#define NRT 16                     // maximum number of real-time tasks
+#define RTMAXUTIL 900              // per mille of one hart that real-time tasks may reserve
 #define STRIN 0
 #define STDOUT 1
 #define STDERR 2
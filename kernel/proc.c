@@ -3,40 +3,74 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
 
-struct proc proc[NPROC];
+// The process table. A struct proc is allocated on demand, at the
+// top of the page that also holds its kernel stack; the page is
+// mapped at KSTACK(slot), above an invalid guard page. Freed procs
+// are kept on a free list, with their kernel stacks still mapped,
+// until kalloc() runs out of memory and calls procreclaim().
+struct {
+  struct spinlock lock;
+  struct proc *slot[NPROC];  // Allocated procs, in use or free
+  int nslot;                 // Slots at or above nslot are all empty
+  struct proc *freelist;     // UNUSED procs, linked through nextfree
+  int kstackgen;             // Bumped whenever a kernel stack is (un)mapped
+} ptable;
 
 struct proc *initproc;
 
 int nextpid = 1;
 struct spinlock pid_lock;
 
+// Hash table from pid to proc, so that kill() does not have to
+// scan the whole process table.
+#define NPIDHASH 64
+struct {
+  struct spinlock lock;
+  struct proc *bucket[NPIDHASH];
+} pidhash;
+
+// Real-time tasks, scheduled earliest deadline first ahead of
+// everything else. A task is named by slot+1 and pid, so that a
+// stale entry can be told from a live one without holding rt.lock.
+struct {
+  struct spinlock lock;
+  int ntask;  // Entries in use
+  int util;   // Sum of the tasks' budget/period, per mille
+  struct {
+    int slot;  // Slot+1, or 0 if the entry is free
+    int pid;
+  } task[NRT];
+} rt;
+
 extern void forkret(void);
 static void wakeup1(struct proc *chan);
+static int kickidle(uint64 mask);
+static void rtremove(struct proc *p);
+static void runproc(struct cpu *c, struct proc *p);
+static struct proc *takehandoff(struct cpu *c);
+static struct proc *pickrt(struct cpu *c);
 static void freeproc(struct proc *p);
 extern char trampoline[];  // trampoline.S
 
 // initialize the proc table at boot time.
 void procinit(void) {
-  struct proc *p;
+  struct cpu *c;
 
   initlock(&pid_lock, "nextpid");
-  for (p = proc; p < &proc[NPROC]; p++) {
-    initlock(&p->lock, "proc");
-
-    // Allocate a page for the process's kernel stack.
-    // Map it high in memory, followed by an invalid
-    // guard page.
-    char *pa = kalloc();
-    if (pa == 0) panic("kalloc");
-    uint64 va = KSTACK((int)(p - proc));
-    kvmmap(va, (uint64)pa, PGSIZE, PTE_R | PTE_W);
-    p->kstack = va;
-  }
+  initlock(&pidhash.lock, "pidhash");
+  initlock(&ptable.lock, "ptable");
+  initlock(&rt.lock, "rt");
+  for (c = cpus; c < &cpus[NCPU]; c++) initlock(&c->walklock, "walk");
+
+  // Create the page-table pages for all the kernel stacks now,
+  // so that mapping one later never has to allocate.
+  kvmprealloc(KSTACK(NPROC - 1), TRAMPOLINE - KSTACK(NPROC - 1));
   kvminithart();
 }
 
@@ -76,45 +110,211 @@ int allocpid() {
   return pid;
 }
 
-// Look in the process table for an UNUSED proc.
-// If found, initialize state required to run in the kernel,
-// and return with p->lock held.
-// If there are no free procs, or a memory allocation fails, return 0.
-static struct proc *allocproc(void) {
-  struct proc *p;
+static void pidhash_insert(struct proc *p) {
+  struct proc **bp = &pidhash.bucket[p->pid % NPIDHASH];
 
-  for (p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if (p->state == UNUSED) {
-      goto found;
-    } else {
-      release(&p->lock);
+  acquire(&pidhash.lock);
+  p->pidnext = *bp;
+  *bp = p;
+  release(&pidhash.lock);
+}
+
+static void pidhash_remove(struct proc *p) {
+  struct proc **pp;
+
+  acquire(&pidhash.lock);
+  for (pp = &pidhash.bucket[p->pid % NPIDHASH]; *pp; pp = &(*pp)->pidnext) {
+    if (*pp == p) {
+      *pp = p->pidnext;
+      break;
     }
   }
-  return 0;
+  p->pidnext = 0;
+  release(&pidhash.lock);
+}
 
-found:
-  p->pid = allocpid();
+// A free proc can be handed back to kalloc() by procreclaim(), so
+// code that picks up a pointer to another proc without holding that
+// proc's lock (from the slot table, the pid hash, or a parent
+// pointer) must hold its cpu's walk lock until it has locked the
+// proc. procreclaim() takes every cpu's walk lock, so walkers only
+// ever contend with it, and never with each other.
+static struct spinlock *walkbegin(void) {
+  struct spinlock *lk;
+
+  push_off();
+  lk = &mycpu()->walklock;
+  acquire(lk);
+  pop_off();
+  return lk;
+}
+
+// Return the proc in slot i, locked, or 0 if the slot is empty.
+static struct proc *lockslot(int i) {
+  struct spinlock *wl;
+  struct proc *p;
+
+  wl = walkbegin();
+  if ((p = ptable.slot[i]) != 0) acquire(&p->lock);
+  release(wl);
+  return p;
+}
+
+// Return the proc with the given pid, locked,
+// or 0 if there is none.
+static struct proc *lockpid(int pid) {
+  struct spinlock *wl;
+  struct proc *p;
+
+  if (pid <= 0) return 0;
 
-  // Allocate a trapframe page.
-  if ((p->trapframe = (struct trapframe *)kalloc()) == 0) {
+  wl = walkbegin();
+  acquire(&pidhash.lock);
+  for (p = pidhash.bucket[pid % NPIDHASH]; p; p = p->pidnext)
+    if (p->pid == pid) break;
+  release(&pidhash.lock);
+  if (p) acquire(&p->lock);
+  release(wl);
+
+  if (p && p->pid != pid) {
+    // exited and was freed since the lookup.
     release(&p->lock);
+    p = 0;
+  }
+  return p;
+}
+
+_Static_assert(KSTACKSIZE >= KSTACKMIN,
+               "struct proc leaves too little of its page for the kernel stack");
+
+// Take a proc off the free list, or allocate a new one,
+// with its kernel stack, in an empty slot.
+// Returns an UNUSED proc, not locked, or 0.
+static struct proc *procget(void) {
+  struct proc *p;
+  char *pa;
+  int i;
+
+  acquire(&ptable.lock);
+  if ((p = ptable.freelist) != 0) {
+    ptable.freelist = p->nextfree;
+    p->nextfree = 0;
+    release(&ptable.lock);
+    return p;
+  }
+  release(&ptable.lock);
+
+  if ((pa = kalloc()) == 0) return 0;
+  p = (struct proc *)(pa + KSTACKSIZE);
+  memset(p, 0, sizeof(*p));
+  initlock(&p->lock, "proc");
+  initlock(&p->filelock, "filelock");
+  initsleeplock(&p->vmlock, "vmlock");
+
+  acquire(&ptable.lock);
+  for (i = 0; i < NPROC; i++)
+    if (ptable.slot[i] == 0) break;
+  if (i == NPROC) {
+    release(&ptable.lock);
+    freelock(&p->lock);
+    freelock(&p->filelock);
+    freesleeplock(&p->vmlock);
+    kfree(pa);
     return 0;
   }
+  p->slot = i;
+  p->kstack = KSTACK(i);
+  kvmmapkstack(p->kstack, (uint64)pa);
+  ptable.kstackgen++;
+  __sync_synchronize();  // initialize p before walkers can see it.
+  ptable.slot[i] = p;
+  if (i >= ptable.nslot) ptable.nslot = i + 1;
+  release(&ptable.lock);
+  return p;
+}
+
+// Give the pages of all free procs back to the page allocator.
+// Called by kalloc() when it runs out of memory; does nothing if
+// the caller holds a spinlock, since it has to wait for other cpus.
+// Returns the number of pages freed.
+int procreclaim(void) {
+  struct proc *p, *list;
+  struct cpu *c;
+  int n;
+
+  push_off();
+  n = mycpu()->noff;
+  pop_off();
+  if (n != 1 || ptable.freelist == 0) return 0;
+
+  // With every walk lock held, nobody can be about to
+  // lock a proc that is not already locked.
+  for (c = cpus; c < &cpus[NCPU]; c++) acquire(&c->walklock);
+  acquire(&ptable.lock);
+  list = ptable.freelist;
+  ptable.freelist = 0;
+  for (p = list; p; p = p->nextfree) ptable.slot[p->slot] = 0;
+  release(&ptable.lock);
+  for (c = cpus; c < &cpus[NCPU]; c++) release(&c->walklock);
+
+  // Wait for anyone who had locked one of them before
+  // it left the slot table.
+  for (p = list; p; p = p->nextfree) {
+    acquire(&p->lock);
+    release(&p->lock);
+  }
 
-  // An empty user page table.
-  p->pagetable = proc_pagetable(p);
-  if (p->pagetable == 0) {
+  acquire(&ptable.lock);
+  for (p = list; p; p = p->nextfree) kvmunmapkstack(p->kstack);
+  ptable.kstackgen++;
+  release(&ptable.lock);
+
+  n = 0;
+  while ((p = list) != 0) {
+    list = p->nextfree;
+    freelock(&p->lock);
+    freelock(&p->filelock);
+    freesleeplock(&p->vmlock);
+    kfree((char *)p - KSTACKSIZE);
+    n++;
+  }
+  return n;
+}
+
+// Get an UNUSED proc from the process table.
+// If found, initialize state required to run in the kernel,
+// and return with p->lock held.
+// If there are no free procs, or a memory allocation fails, return 0.
+static struct proc *allocproc(void) {
+  struct proc *p;
+
+  if ((p = procget()) == 0) return 0;
+
+  // Allocate a trapframe page and an empty user page table.
+  // Nobody else looks at an UNUSED proc that is off the free
+  // list, so p->lock isn't needed yet; not holding it lets
+  // kalloc() reclaim free procs if memory is short.
+  if ((p->trapframe = (struct trapframe *)kalloc()) == 0 ||
+      (p->pagetable = proc_pagetable(p)) == 0) {
+    acquire(&p->lock);
     freeproc(p);
     release(&p->lock);
     return 0;
   }
 
+  acquire(&p->lock);
+  p->pid = allocpid();
+  p->state = USED;
+  p->affinity = -1;
+  p->leader = p;
+  p->tfva = TRAPFRAME;
+  pidhash_insert(p);
+
   // Set up new context to start executing at forkret,
   // which returns to user space.
   memset(&p->context, 0, sizeof(p->context));
   p->context.ra = (uint64)forkret;
-  p->context.sp = p->kstack + PGSIZE;
+  p->context.sp = p->kstack + KSTACKSIZE;
 
   return p;
 }
@@ -125,16 +325,47 @@ found:
 static void freeproc(struct proc *p) {
   if (p->trapframe) kfree((void *)p->trapframe);
   p->trapframe = 0;
-  if (p->pagetable) proc_freepagetable(p->pagetable, p->sz);
+  if (p->pagetable) {
+    if (p->leader && p->leader != p)
+      uvmunmap(p->pagetable, p->tfva, 1, 0);  // the leader's page table
+    else
+      proc_freepagetable(p->pagetable, p->sz);
+  }
   p->pagetable = 0;
   p->sz = 0;
+  if (p->rt_period) {
+    acquire(&rt.lock);
+    rtremove(p);
+    release(&rt.lock);
+  }
+  p->rt_period = 0;
+  p->rt_budget = 0;
+  p->rt_used = 0;
+  p->rt_deadline = 0;
+  p->rt_misses = 0;
+  if (p->pid) pidhash_remove(p);
   p->pid = 0;
   p->parent = 0;
+  p->children = 0;
+  p->nthreads = 0;
+  p->sibling = 0;
+  p->leader = 0;
+  p->ustack = 0;
+  p->alarm_interval = 0;
+  p->alarm_handler = 0;
+  p->alarm_ticks = 0;
+  p->alarm_frame = 0;
+  memset(&p->ru, 0, sizeof(p->ru));
   p->name[0] = 0;
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
   p->state = UNUSED;
+
+  acquire(&ptable.lock);
+  p->nextfree = ptable.freelist;
+  ptable.freelist = p;
+  release(&ptable.lock);
 }
 
 // Create a user page table for a given process,
@@ -208,22 +439,85 @@ void userinit(void) {
   release(&p->lock);
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch here.
+static void kthreadstart(void) {
+  struct proc *p = myproc();
+
+  // Still holding p->lock from scheduler.
+  release(&p->lock);
+  p->kfn(p->karg);
+  panic("kthread returned");
+}
+
+// Start a kernel thread that runs fn(arg): a process with no user
+// memory, which never leaves the kernel and can't be killed. fn
+// must not return. Returns the thread's pid, or -1.
+int kthread(void (*fn)(void *), void *arg, char *name) {
+  struct proc *p;
+  int pid;
+
+  if ((p = procget()) == 0) return -1;
+
+  acquire(&p->lock);
+  p->pid = allocpid();
+  p->state = USED;
+  p->affinity = -1;
+  p->leader = p;
+  p->kfn = fn;
+  p->karg = arg;
+  pidhash_insert(p);
+
+  memset(&p->context, 0, sizeof(p->context));
+  p->context.ra = (uint64)kthreadstart;
+  p->context.sp = p->kstack + KSTACKSIZE;
+
+  safestrcpy(p->name, name, sizeof(p->name));
+  p->state = RUNNABLE;
+  pid = p->pid;
+  release(&p->lock);
+  kickidle(-1);
+  return pid;
+}
+
 // Grow or shrink user memory by n bytes.
-// Return 0 on success, -1 on failure.
+// Return the old size on success, -1 on failure.
+// Threads share the leader's page table, so hold leader->vmlock
+// to change it one thread at a time, then leader->lock just to
+// give every thread the new size. Threads can't shrink it: the
+// other threads' harts may still have the freed pages in their
+// TLBs, and nothing shoots those entries down.
 int growproc(int n) {
-  uint sz;
+  uint sz, oldsz;
   struct proc *p = myproc();
+  struct proc *l = p->leader, *t;
+  int threaded;
 
-  sz = p->sz;
+  acquiresleep(&l->vmlock);
+  sz = oldsz = p->sz;
   if (n > 0) {
     if ((sz = uvmalloc(p->pagetable, sz, sz + n)) == 0) {
+      releasesleep(&l->vmlock);
       return -1;
     }
   } else if (n < 0) {
+    acquire(&l->lock);
+    threaded = (p != l || l->nthreads > 0);
+    release(&l->lock);
+    if (threaded) {
+      releasesleep(&l->vmlock);
+      return -1;
+    }
     sz = uvmdealloc(p->pagetable, sz, sz + n);
   }
-  p->sz = sz;
-  return 0;
+
+  acquire(&l->lock);
+  p->sz = l->sz = sz;
+  for (t = l->children; t; t = t->sibling)
+    if (t->leader == l) t->sz = sz;
+  release(&l->lock);
+  releasesleep(&l->vmlock);
+  return oldsz;
 }
 
 // Create a new process, copying the parent.
@@ -232,23 +526,33 @@ int fork(void) {
   int i, pid;
   struct proc *np;
   struct proc *p = myproc();
+  struct proc *l = p->leader;
 
   // Allocate process.
   if ((np = allocproc()) == 0) {
     return -1;
   }
 
-  // Copy user memory from parent to child.
+  // np is USED, so nobody else will touch it until it is RUNNABLE;
+  // don't hold its lock while copying, so that kalloc() can
+  // reclaim free procs if memory is short.
+  release(&np->lock);
+
+  // Copy user memory from parent to child, holding leader->vmlock
+  // so that no other thread changes it meanwhile.
+  acquiresleep(&l->vmlock);
   if (uvmcopy(p->pagetable, np->pagetable, p->sz) < 0) {
+    releasesleep(&l->vmlock);
+    acquire(&np->lock);
     freeproc(np);
     release(&np->lock);
     return -1;
   }
   np->sz = p->sz;
-
-  np->parent = p;
+  releasesleep(&l->vmlock);
 
   np->trace_syscall_max = p->trace_syscall_max;
+  np->affinity = p->affinity;
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -257,43 +561,194 @@ int fork(void) {
   np->trapframe->a0 = 0;
 
   // increment reference counts on open file descriptors.
+  acquire(&p->leader->filelock);
   for (i = 0; i < NOFILE; i++)
-    if (p->ofile[i]) np->ofile[i] = filedup(p->ofile[i]);
-  np->cwd = idup(p->cwd);
+    if (p->leader->ofile[i]) np->ofile[i] = filedup(p->leader->ofile[i]);
+  np->cwd = idup(p->leader->cwd);
+  release(&p->leader->filelock);
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
   pid = np->pid;
 
+  // link np into p's list of children. the parent-then-child
+  // rule says we have to lock p first.
+  acquire(&p->lock);
+  acquire(&np->lock);
+  np->parent = p;
+  np->sibling = p->children;
+  p->children = np;
   np->state = RUNNABLE;
-
   release(&np->lock);
+  release(&p->lock);
+  kickidle(np->affinity);
 
   return pid;
 }
 
+// Create a thread in the caller's thread group, sharing its page
+// table, open files and current directory. The thread starts in
+// fn(arg), with its stack pointer at stack, and its own trapframe
+// mapped at TTRAPFRAME(slot). Threads are children of the leader.
+// Returns the new thread's pid, or -1.
+int clone(uint64 fn, uint64 arg, uint64 stack) {
+  struct proc *np;
+  struct proc *p = myproc();
+  struct proc *l = p->leader;
+  int tid;
+
+  if ((np = allocproc()) == 0) return -1;
+  release(&np->lock);  // not visible until RUNNABLE, as in fork().
+
+  // use the group's page table instead of the one allocproc() made.
+  proc_freepagetable(np->pagetable, 0);
+  np->pagetable = 0;
+
+  acquiresleep(&l->vmlock);
+  acquire(&l->lock);
+  if (l->killed || p->killed) goto bad;
+  // l->vmlock keeps threads from changing the page table at once.
+  if (mappages(l->pagetable, TTRAPFRAME(np->slot), PGSIZE,
+               (uint64)np->trapframe, PTE_R | PTE_W) < 0)
+    goto bad;
+  np->pagetable = l->pagetable;
+  np->tfva = TTRAPFRAME(np->slot);
+  np->leader = l;
+  np->sz = l->sz;
+  np->ustack = stack;
+  np->trace_syscall_max = p->trace_syscall_max;
+  np->affinity = p->affinity;
+  safestrcpy(np->name, p->name, sizeof(p->name));
+
+  *(np->trapframe) = *(p->trapframe);
+  np->trapframe->epc = fn;
+  np->trapframe->a0 = arg;
+  np->trapframe->sp = stack;
+  np->trapframe->ra = 0;  // fn must not return; it calls exit().
+
+  tid = np->pid;
+
+  acquire(&np->lock);
+  np->parent = l;
+  np->sibling = l->children;
+  l->children = np;
+  l->nthreads++;
+  np->state = RUNNABLE;
+  release(&np->lock);
+  release(&l->lock);
+  releasesleep(&l->vmlock);
+  kickidle(np->affinity);
+
+  return tid;
+
+bad:
+  release(&l->lock);
+  releasesleep(&l->vmlock);
+  acquire(&np->lock);
+  freeproc(np);
+  release(&np->lock);
+  return -1;
+}
+
+// Wait for thread tid of the caller's group, or any thread if tid is
+// 0, to exit. Copies the thread's clone() stack argument out to addr,
+// if addr is not 0, and returns its pid. Only the leader may join.
+int join(int tid, uint64 addr) {
+  struct proc *np, **pp;
+  int havethreads;
+  struct proc *p = myproc();
+
+  if (p->leader != p) return -1;
+
+  acquire(&p->lock);
+  for (;;) {
+    havethreads = 0;
+    for (pp = &p->children; (np = *pp) != 0; pp = &np->sibling) {
+      if (np->leader != p || (tid != 0 && np->pid != tid)) continue;
+      acquire(&np->lock);
+      havethreads = 1;
+      if (np->state == ZOMBIE) {
+        tid = np->pid;
+        if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->ustack,
+                                 sizeof(np->ustack)) < 0) {
+          release(&np->lock);
+          release(&p->lock);
+          return -1;
+        }
+        *pp = np->sibling;
+        p->nthreads--;
+        freeproc(np);
+        release(&np->lock);
+        release(&p->lock);
+        return tid;
+      }
+      release(&np->lock);
+    }
+
+    if (!havethreads || p->killed) {
+      release(&p->lock);
+      return -1;
+    }
+
+    sleep(p, &p->lock);
+  }
+}
+
+// Kill all of leader p's threads and free them once they have
+// exited, so that nothing else uses p's memory and files.
+static void killthreads(struct proc *p) {
+  struct proc *np, **pp;
+
+  acquire(&p->lock);
+  while (p->nthreads > 0) {
+    for (pp = &p->children; (np = *pp) != 0;) {
+      if (np->leader != p) {
+        pp = &np->sibling;
+        continue;
+      }
+      acquire(&np->lock);
+      if (np->state == ZOMBIE) {
+        *pp = np->sibling;
+        p->nthreads--;
+        freeproc(np);
+        release(&np->lock);
+        continue;
+      }
+      np->killed = 1;
+      if (np->state == SLEEPING) {
+        np->state = RUNNABLE;
+        kickidle(np->affinity);
+      }
+      release(&np->lock);
+      pp = &np->sibling;
+    }
+    if (p->nthreads > 0) sleep(p, &p->lock);
+  }
+  release(&p->lock);
+}
+
 // Pass p's abandoned children to init.
-// Caller must hold p->lock.
+// Caller must hold p->lock and initproc->lock.
 void reparent(struct proc *p) {
-  struct proc *pp;
-
-  for (pp = proc; pp < &proc[NPROC]; pp++) {
-    // this code uses pp->parent without holding pp->lock.
-    // acquiring the lock first could cause a deadlock
-    // if pp or a child of pp were also in exit()
-    // and about to try to lock p.
-    if (pp->parent == p) {
-      // pp->parent can't change between the check and the acquire()
-      // because only the parent changes it, and we're the parent.
-      acquire(&pp->lock);
-      pp->parent = initproc;
-      // we should wake up init here, but that would require
-      // initproc->lock, which would be a deadlock, since we hold
-      // the lock on one of init's children (pp). this is why
-      // exit() always wakes init (before acquiring any locks).
-      release(&pp->lock);
-    }
+  struct proc *pp, *last;
+
+  if (p->children == 0) return;
+
+  last = 0;
+  for (pp = p->children; pp; pp = pp->sibling) {
+    acquire(&pp->lock);
+    pp->parent = initproc;
+    release(&pp->lock);
+    last = pp;
   }
+
+  // splice the whole list onto init's children.
+  last->sibling = initproc->children;
+  initproc->children = p->children;
+  p->children = 0;
+
+  // some of them may already be zombies.
+  wakeup1(initproc);
 }
 
 // Exit the current process.  Does not return.
@@ -301,58 +756,71 @@ void reparent(struct proc *p) {
 // until its parent calls wait().
 void exit(int status) {
   struct proc *p = myproc();
+  struct proc *parent;
+  struct spinlock *wl;
+  int lockinit;
 
   if (p == initproc) panic("init exiting");
 
-  // Close all open files.
-  for (int fd = 0; fd < NOFILE; fd++) {
-    if (p->ofile[fd]) {
-      struct file *f = p->ofile[fd];
-      fileclose(f);
-      p->ofile[fd] = 0;
+  // A thread leaves the group's files to the leader, and the
+  // leader takes its threads down with it.
+  if (p->leader == p) {
+    killthreads(p);
+
+    // Close all open files.
+    for (int fd = 0; fd < NOFILE; fd++) {
+      if (p->ofile[fd]) {
+        struct file *f = p->ofile[fd];
+        fileclose(f);
+        p->ofile[fd] = 0;
+      }
     }
-  }
 
-  begin_op();
-  iput(p->cwd);
-  end_op();
-  p->cwd = 0;
-
-  // we might re-parent a child to init. we can't be precise about
-  // waking up init, since we can't acquire its lock once we've
-  // acquired any other proc lock. so wake up init whether that's
-  // necessary or not. init may miss this wakeup, but that seems
-  // harmless.
-  acquire(&initproc->lock);
-  wakeup1(initproc);
-  release(&initproc->lock);
-
-  // grab a copy of p->parent, to ensure that we unlock the same
-  // parent we locked. in case our parent gives us away to init while
-  // we're waiting for the parent lock. we may then race with an
-  // exiting parent, but the result will be a harmless spurious wakeup
-  // to a dead or wrong process; proc structs are never re-allocated
-  // as anything else.
-  acquire(&p->lock);
-  struct proc *original_parent = p->parent;
-  release(&p->lock);
+    begin_op();
+    iput(p->cwd);
+    end_op();
+    p->cwd = 0;
+  }
 
-  // we need the parent's lock in order to wake it up from wait().
-  // the parent-then-child rule says we have to lock it first.
-  acquire(&original_parent->lock);
+  // we need the parent's lock in order to wake it up from wait(),
+  // and init's lock if we have children to hand over to it.
+  // the parent-then-child rule says we have to lock them first;
+  // init is everyone's ancestor, so it goes before the parent.
+  // only our own fork() and wait() change p->children, so it can
+  // be read without p->lock.
+  // our parent may give us away to init while we're waiting for the
+  // parent lock, so check that p->parent is still the proc we locked
+  // and retry if not; the walk lock keeps a stale parent pointer
+  // from being reclaimed in the meantime.
+  for (;;) {
+    wl = walkbegin();
+    acquire(&p->lock);
+    parent = p->parent;
+    release(&p->lock);
 
-  acquire(&p->lock);
+    lockinit = (p->children != 0 && parent != initproc);
+    if (lockinit) acquire(&initproc->lock);
+    acquire(&parent->lock);
+    acquire(&p->lock);
+    if (p->parent == parent) break;
+    release(&p->lock);
+    release(&parent->lock);
+    if (lockinit) release(&initproc->lock);
+    release(wl);
+  }
+  release(wl);
 
   // Give any children to init.
   reparent(p);
 
   // Parent might be sleeping in wait().
-  wakeup1(original_parent);
+  wakeup1(parent);
 
   p->xstate = status;
   p->state = ZOMBIE;
 
-  release(&original_parent->lock);
+  release(&parent->lock);
+  if (lockinit) release(&initproc->lock);
 
   // Jump into the scheduler, never to return.
   sched();
@@ -362,7 +830,7 @@ void exit(int status) {
 // Wait for a child process to exit and return its pid.
 // Return -1 if this process has no children.
 int wait(uint64 addr) {
-  struct proc *np;
+  struct proc *np, **pp;
   int havekids, pid;
   struct proc *p = myproc();
 
@@ -371,33 +839,30 @@ int wait(uint64 addr) {
   acquire(&p->lock);
 
   for (;;) {
-    // Scan through table looking for exited children.
+    // Scan through our children looking for exited ones.
+    // p->lock protects the list, and the parent-then-child
+    // rule lets us lock each child while holding it.
     havekids = 0;
-    for (np = proc; np < &proc[NPROC]; np++) {
-      // this code uses np->parent without holding np->lock.
-      // acquiring the lock first would cause a deadlock,
-      // since np might be an ancestor, and we already hold p->lock.
-      if (np->parent == p) {
-        // np->parent can't change between the check and the acquire()
-        // because only the parent changes it, and we're the parent.
-        acquire(&np->lock);
-        havekids = 1;
-        if (np->state == ZOMBIE) {
-          // Found one.
-          pid = np->pid;
-          if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
-                                   sizeof(np->xstate)) < 0) {
-            release(&np->lock);
-            release(&p->lock);
-            return -1;
-          }
-          freeproc(np);
+    for (pp = &p->children; (np = *pp) != 0; pp = &np->sibling) {
+      if (np->leader == p) continue;  // a thread; see join().
+      acquire(&np->lock);
+      havekids = 1;
+      if (np->state == ZOMBIE) {
+        // Found one.
+        pid = np->pid;
+        if (addr != 0 && copyout(p->pagetable, addr, (char *)&np->xstate,
+                                 sizeof(np->xstate)) < 0) {
           release(&np->lock);
           release(&p->lock);
-          return pid;
+          return -1;
         }
+        *pp = np->sibling;
+        freeproc(np);
         release(&np->lock);
+        release(&p->lock);
+        return pid;
       }
+      release(&np->lock);
     }
 
     // No point waiting if we don't have any children.
@@ -421,36 +886,286 @@ int wait(uint64 addr) {
 void scheduler(void) {
   struct proc *p;
   struct cpu *c = mycpu();
+  int i;
 
   c->proc = 0;
+  c->online = 1;
   for (;;) {
     // Avoid deadlock by ensuring that devices can interrupt.
     intr_on();
 
     int found = 0;
-    for (p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if (p->state == RUNNABLE) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
+    for (i = 0; i < ptable.nslot; i++) {
+      // Real-time tasks with budget left come before anything else.
+      while (rt.ntask > 0 && (p = pickrt(c)) != 0) {
+        runproc(c, p);
+        release(&p->lock);
+        found = 1;
+      }
 
+      if ((p = lockslot(i)) == 0) continue;
+      if (p->state == RUNNABLE && (p->affinity & (1UL << (c - cpus)))) {
+        runproc(c, p);
         found = 1;
       }
       release(&p->lock);
+
+      // If that process went to sleep right after waking a single
+      // peer, run the peer next instead of going on with the scan.
+      while ((p = takehandoff(c)) != 0) {
+        runproc(c, p);
+        release(&p->lock);
+      }
+    }
+    if (found) continue;
+
+    if (TICKLESS && !c->idle) {
+      // Stop the tick, leaving the timer set only for the next
+      // sleep() deadline, and say that we're idle. Then scan once
+      // more, since a process may have become RUNNABLE before
+      // kickidle() could see c->idle.
+      intr_off();
+      c->ticking = 0;
+      timerset(timernext());
+      c->idle = 1;
+      __sync_synchronize();
+      continue;
+    }
+
+    uint64 t0 = *(uint64 *)CLINT_MTIME;
+    intr_on();
+    asm volatile("wfi");
+    c->nidle++;
+    c->idlecycles += *(uint64 *)CLINT_MTIME - t0;
+    // whatever woke us may have used up the timer.
+    c->idle = 0;
+  }
+}
+
+// A process allowed on the harts in mask has become RUNNABLE.
+// If one of them is idle with its tick stopped, make its timer
+// fire now so that it looks for work. Returns 1 if it did.
+static int kickidle(uint64 mask) {
+  struct cpu *c;
+
+  if (!TICKLESS) return 0;
+  __sync_synchronize();
+  for (c = cpus; c < &cpus[NCPU]; c++) {
+    if (!(mask & (1UL << (c - cpus)))) continue;
+    if (c->idle && __sync_lock_test_and_set(&c->idle, 0)) {
+      timerkick(c - cpus);
+      return 1;
     }
-    if (found == 0) {
-      intr_on();
-      asm volatile("wfi");
+  }
+  return 0;
+}
+
+// A real-time task allowed on the harts in mask has become
+// RUNNABLE. If no hart is idle, make one that is running an
+// ordinary process take a timer interrupt now; usertrap() or
+// kerneltrap() then yields, and scheduler() picks the task
+// rather than leaving it to wait for the next tick.
+void kickrt(uint64 mask) {
+  struct spinlock *wl;
+  struct cpu *c;
+  struct proc *p;
+
+  if (kickidle(mask)) return;
+  // the walk lock keeps c->proc from being reclaimed under us.
+  wl = walkbegin();
+  for (c = cpus; c < &cpus[NCPU]; c++) {
+    if (!(mask & (1UL << (c - cpus))) || !c->online) continue;
+    if ((p = c->proc) != 0 && p->rt_period == 0) {
+      timerkick(c - cpus);
+      break;
     }
   }
+  release(wl);
+}
+
+// Whether real-time task p may run as such on c now.
+static int rtready(struct proc *p, struct cpu *c) {
+  return p->rt_period && p->rt_used < p->rt_budget &&
+         (p->affinity & (1UL << (c - cpus)));
+}
+
+// Return the RUNNABLE real-time task with the earliest deadline
+// that has budget left and may run on c, locked; or 0 if there
+// is none. A task that has used up its budget runs only as an
+// ordinary process until its next period.
+static struct proc *pickrt(struct cpu *c) {
+  struct spinlock *wl;
+  struct proc *p;
+  int i, best = -1, bestpid = 0;
+  uint bestdl = 0;
+
+  // Look without the proc locks, so as never to hold two of
+  // them at once, then lock the winner and check again.
+  wl = walkbegin();
+  for (i = 0; i < NRT; i++) {
+    if (rt.task[i].slot == 0) continue;
+    if ((p = ptable.slot[rt.task[i].slot - 1]) == 0) continue;
+    if (p->pid != rt.task[i].pid || p->state != RUNNABLE || !rtready(p, c))
+      continue;
+    if (best < 0 || (int)(p->rt_deadline - bestdl) < 0) {
+      best = p->slot;
+      bestpid = p->pid;
+      bestdl = p->rt_deadline;
+    }
+  }
+  release(wl);
+
+  if (best < 0 || (p = lockslot(best)) == 0) return 0;
+  if (p->pid == bestpid && p->state == RUNNABLE && rtready(p, c)) return p;
+  release(&p->lock);
+  return 0;
+}
+
+// Per mille of a hart that budget ticks every period ticks
+// reserves, rounded up.
+static int rtutil(int budget, int period) {
+  return (budget * 1000 + period - 1) / period;
+}
+
+// Drop p's entry from the real-time table.
+// Caller must hold rt.lock.
+static void rtremove(struct proc *p) {
+  int i;
+
+  for (i = 0; i < NRT; i++) {
+    if (rt.task[i].slot == p->slot + 1 && rt.task[i].pid == p->pid) {
+      rt.task[i].slot = 0;
+      rt.ntask--;
+      rt.util -= rtutil(p->rt_budget, p->rt_period);
+      return;
+    }
+  }
+}
+
+// Make the calling process a real-time task whose jobs need up to
+// budget ticks of CPU every period ticks, or an ordinary process
+// again if period is 0. Refuses if the real-time tasks together
+// would reserve more than RTMAXUTIL per mille of one hart, which
+// is what lets earliest-deadline-first meet every deadline.
+int rtsched(int period, int budget) {
+  struct proc *p = myproc();
+  int i, u, old;
+  uint now;
+
+  if (period < 0 || (period > 0 && (budget <= 0 || budget > period)))
+    return -1;
+  u = period ? rtutil(budget, period) : 0;
+  old = p->rt_period ? rtutil(p->rt_budget, p->rt_period) : 0;
+
+  acquire(&rt.lock);
+  if (rt.util - old + u > RTMAXUTIL) {
+    release(&rt.lock);
+    return -1;
+  }
+  if (p->rt_period == 0 && period > 0) {
+    for (i = 0; i < NRT && rt.task[i].slot != 0; i++)
+      ;
+    if (i == NRT) {
+      release(&rt.lock);
+      return -1;
+    }
+    rt.task[i].pid = p->pid;
+    rt.task[i].slot = p->slot + 1;
+    rt.ntask++;
+  } else if (p->rt_period > 0 && period == 0) {
+    rtremove(p);
+    old = 0;
+  }
+  rt.util += u - old;
+  release(&rt.lock);
+
+  now = tickcount();
+
+  acquire(&p->lock);
+  p->rt_period = period;
+  p->rt_budget = period ? budget : 0;
+  p->rt_used = 0;
+  p->rt_deadline = now + period;
+  p->rt_misses = 0;
+  release(&p->lock);
+  return 0;
+}
+
+// End the calling real-time task's job for this period: sleep
+// until the next period begins, then renew the budget. A job that
+// ends at or after its deadline is a miss, and its next period
+// starts now instead of in the past.
+// Returns the number of misses so far, or -1.
+int rtwait(void) {
+  struct proc *p = myproc();
+  uint start, now;
+
+  if (p->rt_period == 0) return -1;
+
+  now = tickcount();
+  if ((int)(now - p->rt_deadline) >= 0) {
+    p->rt_misses++;
+    p->rt_deadline = now;
+  }
+  start = p->rt_deadline;
+  if (sleepuntil(start) < 0) return -1;
+  acquire(&p->lock);
+  p->rt_deadline = start + p->rt_period;
+  p->rt_used = 0;
+  release(&p->lock);
+  return p->rt_misses;
+}
+
+// Run RUNNABLE p on c until it gives up the CPU.
+// Called from scheduler() with p->lock held.
+static void runproc(struct cpu *c, struct proc *p) {
+  // Kernel stacks have been mapped or unmapped since this
+  // cpu last flushed its TLB, and p's may be one of them.
+  if (c->kstackgen != ptable.kstackgen) {
+    c->kstackgen = ptable.kstackgen;
+    sfence_vma();
+  }
+
+  // Restart the preemption tick if it was stopped.
+  c->idle = 0;
+  if (!c->ticking) {
+    timerset(*(uint64 *)CLINT_MTIME + TICKINTERVAL);
+    c->ticking = 1;
+  }
+
+  // Switch to chosen process.  It is the process's job
+  // to release its lock and then reacquire it
+  // before jumping back to us.
+  p->state = RUNNING;
+  c->proc = p;
+  swtch(&c->context, &p->context);
+
+  // Process is done running for now.
+  // It should have changed its p->state before coming back.
+  c->proc = 0;
+
+  // It may have yielded because it can no longer run here.
+  if (p->state == RUNNABLE && !(p->affinity & (1UL << (c - cpus))))
+    kickidle(p->affinity);
+}
+
+// Return, locked, the process that c's last process handed the
+// CPU to when it went to sleep, if it is still RUNNABLE and may
+// run on c; see wakeuphandoff().
+static struct proc *takehandoff(struct cpu *c) {
+  struct proc *p;
+  int slot = c->handoff - 1;
+
+  if (c->handoff == 0) return 0;
+  c->handoff = 0;
+  if ((p = lockslot(slot)) == 0) return 0;
+  if (p->pid == c->handoffpid && p->state == RUNNABLE &&
+      (p->affinity & (1UL << (c - cpus)))) {
+    c->nhandoff++;
+    return p;
+  }
+  release(&p->lock);
+  return 0;
 }
 
 // Switch to scheduler.  Must hold only p->lock
@@ -478,6 +1193,7 @@ void sched(void) {
 void yield(void) {
   struct proc *p = myproc();
   acquire(&p->lock);
+  p->ru.nivcsw++;
   p->state = RUNNABLE;
   sched();
   release(&p->lock);
@@ -502,9 +1218,10 @@ void forkret(void) {
   usertrapret();
 }
 
-// Atomically release lock and sleep on chan.
+// Atomically release lock and sleep on chan, giving the hart to
+// the process our last wakeuphandoff() woke if handoff is set.
 // Reacquires lock when awakened.
-void sleep(void *chan, struct spinlock *lk) {
+static void sleep1(void *chan, struct spinlock *lk, int handoff) {
   struct proc *p = myproc();
 
   // Must acquire p->lock in order to
@@ -519,9 +1236,18 @@ void sleep(void *chan, struct spinlock *lk) {
   }
 
   // Go to sleep.
+  p->ru.nvcsw++;
   p->chan = chan;
   p->state = SLEEPING;
 
+  // Ask the scheduler to run the process we just woke, if any.
+  // Either way the handoff is spent.
+  if (handoff && p->handoff) {
+    mycpu()->handoff = p->handoff;
+    mycpu()->handoffpid = p->handoffpid;
+  }
+  p->handoff = 0;
+
   sched();
 
   // Tidy up.
@@ -534,18 +1260,98 @@ void sleep(void *chan, struct spinlock *lk) {
   }
 }
 
+// Atomically release lock and sleep on chan.
+// Reacquires lock when awakened.
+void sleep(void *chan, struct spinlock *lk) { sleep1(chan, lk, 0); }
+
+// sleep(), for pipes, which wake their peer with wakeuphandoff().
+// Only these sleeps take the handoff, so a process that woke a
+// pipe peer and then waits for something else (a child, the
+// disk) doesn't give its hart to the peer.
+void sleephandoff(void *chan, struct spinlock *lk) {
+  sleep1(chan, lk, 1);
+}
+
 // Wake up all processes sleeping on chan.
 // Must be called without any p->lock.
 void wakeup(void *chan) {
+  struct spinlock *wl;
   struct proc *p;
+  int i;
+  uint64 woke = 0, rtwoke = 0;
+
+  wl = walkbegin();
+  for (i = 0; i < ptable.nslot; i++) {
+    if ((p = ptable.slot[i]) == 0) continue;
+    acquire(&p->lock);
+    if (p->state == SLEEPING && p->chan == chan) {
+      p->state = RUNNABLE;
+      if (p->rt_period)
+        rtwoke |= p->affinity;
+      else
+        woke |= p->affinity;
+    }
+    release(&p->lock);
+  }
+  release(wl);
+  if (rtwoke) kickrt(rtwoke);
+  if (woke) kickidle(woke);
+}
 
-  for (p = proc; p < &proc[NPROC]; p++) {
+// Like wakeup(), but if it wakes exactly one process, remember
+// that process so that if the caller next sleeps in
+// sleephandoff(), this hart switches straight to it instead of
+// scanning the process table (a request/response ping-pong over
+// a pipe, say). Process context only.
+void wakeuphandoff(void *chan) {
+  struct spinlock *wl;
+  struct proc *p, *me = myproc();
+  int i, n = 0;
+  uint64 woke = 0, rtwoke = 0;
+
+  me->handoff = 0;
+  wl = walkbegin();
+  for (i = 0; i < ptable.nslot; i++) {
+    if ((p = ptable.slot[i]) == 0) continue;
     acquire(&p->lock);
     if (p->state == SLEEPING && p->chan == chan) {
       p->state = RUNNABLE;
+      if (p->rt_period)
+        rtwoke |= p->affinity;
+      else
+        woke |= p->affinity;
+      if (n++ == 0) {
+        me->handoff = i + 1;
+        me->handoffpid = p->pid;
+      }
     }
     release(&p->lock);
   }
+  release(wl);
+  if (n != 1) me->handoff = 0;
+  if (rtwoke) kickrt(rtwoke);
+  if (woke) kickidle(woke);
+}
+
+// Wake p if it is sleeping on chan. Cheaper than wakeup() when
+// the caller knows which process is waiting, and knows that it
+// can't be freed meanwhile. Must be called without p->lock.
+void wakeupproc(struct proc *p, void *chan) {
+  uint64 woke = 0;
+  int rt = 0;
+
+  acquire(&p->lock);
+  if (p->state == SLEEPING && p->chan == chan) {
+    p->state = RUNNABLE;
+    woke = p->affinity;
+    rt = p->rt_period != 0;
+  }
+  release(&p->lock);
+  // kickrt() takes the walk lock, which comes before p->lock.
+  if (woke && rt)
+    kickrt(woke);
+  else if (woke)
+    kickidle(woke);
 }
 
 // Wake up p if it is sleeping in wait(); used by exit().
@@ -554,6 +1360,7 @@ static void wakeup1(struct proc *p) {
   if (!holding(&p->lock)) panic("wakeup1");
   if (p->chan == p && p->state == SLEEPING) {
     p->state = RUNNABLE;
+    kickidle(p->affinity);
   }
 }
 
@@ -563,20 +1370,126 @@ static void wakeup1(struct proc *p) {
 int kill(int pid) {
   struct proc *p;
 
-  for (p = proc; p < &proc[NPROC]; p++) {
-    acquire(&p->lock);
-    if (p->pid == pid) {
-      p->killed = 1;
-      if (p->state == SLEEPING) {
-        // Wake process from sleep().
-        p->state = RUNNABLE;
-      }
+  if ((p = lockpid(pid)) == 0) return -1;
+  if (p->kfn) {
+    release(&p->lock);
+    return -1;
+  }
+
+  p->killed = 1;
+  if (p->state == SLEEPING) {
+    // Wake process from sleep().
+    p->state = RUNNABLE;
+    kickidle(p->affinity);
+  }
+  release(&p->lock);
+  return 0;
+}
+
+// Restrict process pid (0 for the caller) to the harts in mask.
+// Returns -1 if there is no such process, or if mask
+// leaves it no hart that is running.
+int setaffinity(int pid, uint64 mask) {
+  struct proc *p;
+  struct cpu *c;
+  uint64 online = 0;
+
+  for (c = cpus; c < &cpus[NCPU]; c++)
+    if (c->online) online |= 1UL << (c - cpus);
+  if ((mask & online) == 0) return -1;
+
+  if (pid == 0) pid = myproc()->pid;
+  if ((p = lockpid(pid)) == 0) return -1;
+  p->affinity = mask;
+  if (p->state == RUNNABLE) kickidle(mask);
+  release(&p->lock);
+
+  // move off this hart if we may no longer run here.
+  if (p == myproc()) {
+    push_off();
+    int id = cpuid();
+    pop_off();
+    if (!(mask & (1UL << id))) yield();
+  }
+  return 0;
+}
+
+// Get the hart mask of process pid (0 for the caller).
+int getaffinity(int pid, uint64 *mask) {
+  struct proc *p;
+
+  if (pid == 0) pid = myproc()->pid;
+  if ((p = lockpid(pid)) == 0) return -1;
+  *mask = p->affinity;
+  release(&p->lock);
+  return 0;
+}
+
+static char *states[] = {[UNUSED] "unused",
+                         [USED] "used  ",
+                         [SLEEPING] "sleep ",
+                         [RUNNABLE] "runble",
+                         [RUNNING] "run   ",
+                         [ZOMBIE] "zombie"};
+
+// Fill in *st for p. Caller must hold p->lock.
+static void procstat(struct proc *p, struct procstat *st) {
+  st->pid = p->pid;
+  st->ppid = p->parent ? p->parent->pid : 0;
+  safestrcpy(st->state, states[p->state], sizeof(st->state));
+  safestrcpy(st->name, p->name, sizeof(st->name));
+  st->ru = p->ru;
+}
+
+// Copy the resource usage of process pid (0 for the caller)
+// out to user address addr.
+int getrusage(int pid, uint64 addr) {
+  struct proc *p;
+  struct rusage ru;
+
+  if (pid == 0) pid = myproc()->pid;
+  if ((p = lockpid(pid)) == 0) return -1;
+  ru = p->ru;
+  release(&p->lock);
+  return copyout(myproc()->pagetable, addr, (char *)&ru, sizeof(ru));
+}
+
+// Whether the process with the given pid, in the given slot of
+// the process table, is running on a hart right now. Only a hint:
+// it is read without p->lock and may change at once.
+int procrunning(int slot, int pid) {
+  struct spinlock *wl;
+  struct proc *p;
+  int r = 0;
+
+  if (slot < 0 || slot >= NPROC) return 0;
+  wl = walkbegin();
+  if ((p = ptable.slot[slot]) != 0) r = p->pid == pid && p->state == RUNNING;
+  release(wl);
+  return r;
+}
+
+// Copy a struct procstat for each process, up to n of them,
+// out to the array at user address addr. Returns how many.
+int pstat(uint64 addr, int n) {
+  struct proc *p;
+  struct procstat st;
+  int i, k = 0;
+
+  for (i = 0; i < ptable.nslot && k < n; i++) {
+    if ((p = lockslot(i)) == 0) continue;
+    if (p->state == UNUSED) {
       release(&p->lock);
-      return 0;
+      continue;
     }
+    procstat(p, &st);
     release(&p->lock);
+    if (copyout(myproc()->pagetable, addr + k * sizeof(st), (char *)&st,
+                sizeof(st)) < 0)
+      return -1;
+    k++;
   }
-  return -1;
+  return k;
 }
 
 // Copy to either a user address, or kernel address,
@@ -607,19 +1520,18 @@ int either_copyin(void *dst, int user_src, uint64 src, uint64 len) {
 
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
-// No lock to avoid wedging a stuck machine further.
+// No proc locks to avoid wedging a stuck machine further,
+// just the walk lock so that no proc is reclaimed under us.
 void procdump(void) {
-  static char *states[] = {[UNUSED] "unused",
-                           [SLEEPING] "sleep ",
-                           [RUNNABLE] "runble",
-                           [RUNNING] "run   ",
-                           [ZOMBIE] "zombie"};
+  struct spinlock *wl;
   struct proc *p;
   char *state;
+  int i;
 
   printf("\n");
-  for (p = proc; p < &proc[NPROC]; p++) {
-    if (p->state == UNUSED) continue;
+  wl = walkbegin();
+  for (i = 0; i < ptable.nslot; i++) {
+    if ((p = ptable.slot[i]) == 0 || p->state == UNUSED) continue;
     if (p->state >= 0 && p->state < NELEM(states) && states[p->state])
       state = states[p->state];
     else
@@ -627,13 +1539,26 @@ void procdump(void) {
     printf("%d %s %s", p->pid, state, p->name);
     printf("\n");
   }
+  release(wl);
+
+  // how often each hart has woken up, and how long it has idled.
+  uint64 now = *(uint64 *)CLINT_MTIME;
+  for (struct cpu *c = cpus; c < &cpus[NCPU]; c++) {
+    if (c->ntimer == 0 && c->nidle == 0) continue;
+    printf("cpu %d: %d timer intrs, %d wfi, %d%% idle, %d handoffs\n",
+           (int)(c - cpus), (int)c->ntimer, (int)c->nidle,
+           (int)(c->idlecycles * 100 / now), (int)c->nhandoff);
+  }
 }
 
 uint64 getProcessUnusedCount(){
+  struct spinlock *wl;
   struct proc * p;
   uint64 ProcessUnusedCount = 0;
-  for (p = proc; p < &proc[NPROC]; p++) {
-    if (p->state != UNUSED) ProcessUnusedCount++;  
+  wl = walkbegin();
+  for (int i = 0; i < ptable.nslot; i++) {
+    if ((p = ptable.slot[i]) != 0 && p->state != UNUSED) ProcessUnusedCount++;
   }
+  release(wl);
   return ProcessUnusedCount;
 }
\ No newline at end of file
@@ -24,6 +24,18 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  struct spinlock walklock;   // Held while finding another proc; see walkbegin()
+  int kstackgen;              // ptable.kstackgen as of this cpu's last TLB flush
+  int ticking;                // Preemption tick is programmed
+  uint64 deadline;            // mtime last passed to timerset()
+  int idle;                   // In wfi with no tick; see kickidle()
+  int online;                 // This hart has entered scheduler()
+  int handoff;                // Slot+1 of the process to run next, or 0
+  int handoffpid;             // ... and its pid, in case the slot was reused
+  uint64 nhandoff;            // Handoffs taken
+  uint64 ntimer;              // Timer interrupts taken
+  uint64 nidle;               // Times in wfi
+  uint64 idlecycles;          // mtime cycles spent in wfi
 };
 
 extern struct cpu cpus[NCPU];
@@ -80,7 +92,9 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
-enum procstate { UNUSED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
+#include "rusage.h"
+
+enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
 struct proc {
@@ -94,14 +108,59 @@ struct proc {
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
   int trace_syscall_max;       // If non-zero, trace sysycall whose syscall number is less than it
+  uint64 affinity;             // Bit i set if the process may run on hart i
+  struct proc *children;       // First child; children are linked through sibling
+  int nthreads;                // Leader only: number of threads, not counting itself
+
+  // parent->lock must be held when using this:
+  struct proc *sibling;        // Next child of the same parent
+
+  // pidhash.lock must be held when using this:
+  struct proc *pidnext;        // Next process in the same PID hash bucket
+
+  // ptable.lock must be held when using this:
+  struct proc *nextfree;       // Next proc on the free list
+
+  // leader->vmlock must be held when changing the group's page table
+  // or its size, and while copying it.
+  struct sleeplock vmlock;     // Leader only: protects the group's address space
+
+  // once there are threads, leader->filelock must be held when using these:
+  struct spinlock filelock;    // Leader only: protects the group's ofile and cwd
+  struct file *ofile[NOFILE];  // Open files (leader only; threads use leader's)
+  struct inode *cwd;           // Current directory (leader only)
 
   // these are private to the process, so p->lock need not be held.
+  struct proc *leader;         // Thread group leader; p itself unless p is a thread
+  uint64 tfva;                 // Where trapframe is mapped in pagetable
+  uint64 ustack;               // Thread: clone()'s stack argument, for join()
+  int alarm_interval;          // sigalarm(): CPU ticks between upcalls, or 0
+  int alarm_ticks;             // CPU ticks used since the last upcall
+  uint64 alarm_handler;        // sigalarm(): user address of the handler
+  uint64 alarm_frame;          // User address of the sigframe, while in the handler
+  struct rusage ru;            // Resource usage; others read it under p->lock
+  int handoff;                 // Slot+1 of the one process our last wakeuphandoff() woke
+  int handoffpid;              // ... and its pid
+  int rt_period;               // rtsched(): ticks between job releases, or 0 if not real-time
+  int rt_budget;               // rtsched(): ticks of CPU each job may use
+  int rt_used;                 // Ticks used by the current job
+  uint rt_deadline;            // Tick at which the current period ends
+  int rt_misses;               // Jobs that finished after their deadline
+  int slot;                    // Index in the process table
+  void (*kfn)(void *);         // kthread(): what a kernel thread runs, else 0
+  void *karg;                  // ... and its argument
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
-  struct file *ofile[NOFILE];  // Open files
-  struct inode *cwd;           // Current directory
   char name[16];               // Process name (debugging)
 };
+
+// struct proc sits at the top of its kernel stack's page,
+// and the stack gets the rest, which must be at least KSTACKMIN:
+// the deepest kernel paths (kalloc() reclaiming buffers, a disk
+// interrupt finishing read-ahead on top of a file read) need about
+// that much. A field that takes the stack below it won't compile.
+#define KSTACKSIZE ((PGSIZE - sizeof(struct proc)) & ~0xfUL)
+#define KSTACKMIN 3072
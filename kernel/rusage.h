@@ -0,0 +1,21 @@
+// resource usage of one process, from getrusage() and pstat().
+struct rusage {
+  uint64 utime;     // timer ticks spent in user space
+  uint64 stime;     // timer ticks spent in the kernel
+  uint64 nvcsw;     // voluntary context switches (sleeps)
+  uint64 nivcsw;    // involuntary context switches (preemptions)
+  uint64 nfault;    // page faults
+  uint64 nsyscall;  // system calls
+  uint64 inblock;   // disk blocks read
+  uint64 oublock;   // disk blocks written
+  uint64 hitblock;  // block reads found in the buffer cache
+};
+
+// one entry of the process list from pstat().
+struct procstat {
+  int pid;
+  int ppid;         // 0 if none
+  char state[8];    // as in procdump()
+  char name[16];
+  struct rusage ru;
+};
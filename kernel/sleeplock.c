@@ -6,8 +6,8 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
-#include "proc.h"
 #include "sleeplock.h"
+#include "proc.h"
 
 void
 initsleeplock(struct sleeplock *lk, char *name)
@@ -16,17 +16,52 @@ initsleeplock(struct sleeplock *lk, char *name)
   lk->name = name;
   lk->locked = 0;
   lk->pid = 0;
+  lk->slot = -1;
+  lockstatinit(&lk->stat, name, 1);
+}
+
+// Forget a sleeplock that was initsleeplock()ed
+// in memory about to be freed.
+void
+freesleeplock(struct sleeplock *lk)
+{
+  lockstatfree(&lk->stat);
+  freelock(&lk->lk);
 }
 
+// If the holder is running on another hart, it is likely to let
+// go soon (it is often in bread() or an inode update), so spin
+// for up to SLEEPSPIN cycles before paying for a sleep and a
+// wakeup's two context switches.
 void
 acquiresleep(struct sleeplock *lk)
 {
+  uint64 t = r_time(), spins = 0;
+
   acquire(&lk->lk);
-  while (lk->locked) {
-    sleep(lk, &lk->lk);
+  if (lk->locked) {
+    lk->stat.ncontended++;
+    if (SLEEPSPIN > 0) {
+      release(&lk->lk);
+      while (*(volatile uint *)&lk->locked && r_time() - t < SLEEPSPIN &&
+             procrunning(lk->slot, lk->pid))
+        spins++;
+      acquire(&lk->lk);
+      lk->stat.nspin += spins;
+    }
+    if (lk->locked) {
+      lk->stat.nsleep++;
+      while (lk->locked) {
+        sleep(lk, &lk->lk);
+      }
+    }
+    lk->stat.waitcycles += r_time() - t;
   }
   lk->locked = 1;
   lk->pid = myproc()->pid;
+  lk->slot = myproc()->slot;
+  lk->stat.nacquire++;
+  lk->stat.t0 = r_time();
   release(&lk->lk);
 }
 
@@ -34,8 +69,11 @@ void
 releasesleep(struct sleeplock *lk)
 {
   acquire(&lk->lk);
+  if (r_time() - lk->stat.t0 > lk->stat.maxhold)
+    lk->stat.maxhold = r_time() - lk->stat.t0;
   lk->locked = 0;
   lk->pid = 0;
+  lk->slot = -1;
   wakeup(lk);
   release(&lk->lk);
 }
@@ -51,5 +89,111 @@ holdingsleep(struct sleeplock *lk)
   return r;
 }
 
+void
+initrwsleeplock(struct rwsleeplock *lk, char *name)
+{
+  initlock(&lk->lk, "rw sleep lock");
+  lk->name = name;
+  lk->locked = 0;
+  lk->readers = 0;
+  lk->wwait = 0;
+  lk->pid = 0;
+  lockstatinit(&lk->stat, name, 1);
+}
+
+// Acquire lk exclusively, waiting for every holder to let go.
+void
+acquirerwsleep(struct rwsleeplock *lk)
+{
+  uint64 t = r_time();
+
+  acquire(&lk->lk);
+  if (lk->locked || lk->readers) {
+    lk->stat.ncontended++;
+    lk->stat.nsleep++;
+    lk->wwait++;
+    while (lk->locked || lk->readers) {
+      sleep(lk, &lk->lk);
+    }
+    lk->wwait--;
+    lk->stat.waitcycles += r_time() - t;
+  }
+  lk->locked = 1;
+  lk->pid = myproc()->pid;
+  lk->stat.nacquire++;
+  lk->stat.t0 = r_time();
+  release(&lk->lk);
+}
+
+void
+releaserwsleep(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  if (r_time() - lk->stat.t0 > lk->stat.maxhold)
+    lk->stat.maxhold = r_time() - lk->stat.t0;
+  lk->locked = 0;
+  lk->pid = 0;
+  wakeup(lk);
+  release(&lk->lk);
+}
+
+// Acquire lk shared with other readers. Waits behind an exclusive
+// acquirer that is already waiting, so that a steady stream of
+// readers can't starve it.
+void
+acquirerwsleep_shared(struct rwsleeplock *lk)
+{
+  uint64 t = r_time();
+
+  acquire(&lk->lk);
+  if (lk->locked || lk->wwait) {
+    lk->stat.ncontended++;
+    lk->stat.nsleep++;
+    while (lk->locked || lk->wwait) {
+      sleep(lk, &lk->lk);
+    }
+    lk->stat.waitcycles += r_time() - t;
+  }
+  if (lk->readers++ == 0)
+    lk->stat.t0 = r_time();
+  lk->stat.nacquire++;
+  release(&lk->lk);
+}
+
+void
+releaserwsleep_shared(struct rwsleeplock *lk)
+{
+  acquire(&lk->lk);
+  if (lk->readers < 1)
+    panic("releaserwsleep_shared");
+  if (--lk->readers == 0) {
+    if (r_time() - lk->stat.t0 > lk->stat.maxhold)
+      lk->stat.maxhold = r_time() - lk->stat.t0;
+    wakeup(lk);
+  }
+  release(&lk->lk);
+}
+
+// Is lk held exclusively by the calling process?
+int
+holdingrwsleep(struct rwsleeplock *lk)
+{
+  int r;
+
+  acquire(&lk->lk);
+  r = lk->locked && (lk->pid == myproc()->pid);
+  release(&lk->lk);
+  return r;
+}
 
+// Is lk held, shared or exclusively?
+int
+heldrwsleep(struct rwsleeplock *lk)
+{
+  int r;
 
+  acquire(&lk->lk);
+  r = lk->locked || lk->readers > 0;
+  release(&lk->lk);
+  return r;
+}
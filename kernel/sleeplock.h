@@ -6,5 +6,25 @@ struct sleeplock {
   // For debugging:
   char *name;        // Name of lock.
   int pid;           // Process holding lock
+  int slot;          // ... and its slot in the process table
+
+  // Statistics, under lk:
+  struct lockstat stat;
+};
+
+// Reader-writer sleep lock: any number of shared holders,
+// or one exclusive holder.
+struct rwsleeplock {
+  uint locked;       // Is the lock held exclusively?
+  int readers;       // Number of shared holders
+  int wwait;         // Exclusive acquirers waiting
+  struct spinlock lk; // spinlock protecting this sleep lock
+
+  // For debugging:
+  char *name;        // Name of lock.
+  int pid;           // Process holding lock exclusively
+
+  // Statistics, under lk:
+  struct lockstat stat;
 };
 
@@ -5,32 +5,99 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "riscv.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
 
+// Every spinlock and sleeplock, for the statistics device.
+// The lock protecting the list is not itself on it.
+struct {
+  struct spinlock lock;
+  struct lockstat *head;
+} locklist = { .lock = { .name = "locklist" } };
+
+// Put st on the list of all locks, with zeroed counters.
+void
+lockstatinit(struct lockstat *st, char *name, int sleep)
+{
+  memset(st, 0, sizeof(*st));
+  st->name = name;
+  st->sleep = sleep;
+  acquire(&locklist.lock);
+  st->next = locklist.head;
+  if(locklist.head)
+    locklist.head->prev = st;
+  locklist.head = st;
+  release(&locklist.lock);
+}
+
+// Take st off the list of all locks,
+// before the memory holding it is freed.
+void
+lockstatfree(struct lockstat *st)
+{
+  acquire(&locklist.lock);
+  if(st->prev)
+    st->prev->next = st->next;
+  else
+    locklist.head = st->next;
+  if(st->next)
+    st->next->prev = st->prev;
+  st->next = st->prev = 0;
+  release(&locklist.lock);
+}
+
 void
 initlock(struct spinlock *lk, char *name)
 {
   lk->name = name;
   lk->locked = 0;
+  lk->next = 0;
+  lk->owner = 0;
   lk->cpu = 0;
+  if(lk != &locklist.lock)
+    lockstatinit(&lk->stat, name, 0);
+}
+
+// Forget a lock that was initlock()ed in memory about to be freed.
+void
+freelock(struct spinlock *lk)
+{
+  lockstatfree(&lk->stat);
 }
 
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
+//
+// With TICKETLOCK, each acquirer takes a ticket and waits for
+// its number to come up, so harts get the lock in the order they
+// asked for it, and waiters only read the lock's cache line
+// until the holder's release writes it.
 void
 acquire(struct spinlock *lk)
 {
+  uint64 spins = 0, t = 0;
+
   push_off(); // disable interrupts to avoid deadlock.
   if(holding(lk))
     panic("acquire");
 
+#if TICKETLOCK
+  // On RISC-V, sync_fetch_and_add turns into an atomic add:
+  //   amoadd.w a5, a4, (s1)
+  uint ticket = __sync_fetch_and_add(&lk->next, 1);
+  while(__atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE) != ticket)
+    if(spins++ == 0)
+      t = r_time();
+#else
   // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
   //   a5 = 1
   //   s1 = &lk->locked
   //   amoswap.w.aq a5, a5, (s1)
   while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
-    ;
+    if(spins++ == 0)
+      t = r_time();
+#endif
 
   // Tell the C compiler and the processor to not move loads or stores
   // past this point, to ensure that the critical section's memory
@@ -40,6 +107,13 @@ acquire(struct spinlock *lk)
 
   // Record info about lock acquisition for holding() and debugging.
   lk->cpu = mycpu();
+  lk->stat.nacquire++;
+  if(spins){
+    lk->stat.ncontended++;
+    lk->stat.nspin += spins;
+    lk->stat.waitcycles += r_time() - t;
+  }
+  lk->stat.t0 = r_time();
 }
 
 // Release the lock.
@@ -49,6 +123,10 @@ release(struct spinlock *lk)
   if(!holding(lk))
     panic("release");
 
+  uint64 held = r_time() - lk->stat.t0;
+  if(held > lk->stat.maxhold)
+    lk->stat.maxhold = held;
+
   lk->cpu = 0;
 
   // Tell the C compiler and the CPU to not move loads or stores
@@ -59,6 +137,11 @@ release(struct spinlock *lk)
   // On RISC-V, this emits a fence instruction.
   __sync_synchronize();
 
+#if TICKETLOCK
+  // Let the next ticket in. Only the holder writes owner, so a
+  // plain increment will do.
+  __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+#else
   // Release the lock, equivalent to lk->locked = 0.
   // This code doesn't use a C assignment, since the C standard
   // implies that an assignment might be implemented with
@@ -67,6 +150,7 @@ release(struct spinlock *lk)
   //   s1 = &lk->locked
   //   amoswap.w zero, zero, (s1)
   __sync_lock_release(&lk->locked);
+#endif
 
   pop_off();
 }
@@ -77,7 +161,11 @@ int
 holding(struct spinlock *lk)
 {
   int r;
+#if TICKETLOCK
+  r = (lk->owner != lk->next && lk->cpu == mycpu());
+#else
   r = (lk->locked && lk->cpu == mycpu());
+#endif
   return r;
 }
 
@@ -108,3 +196,86 @@ pop_off(void)
   if(c->noff == 0 && c->intena)
     intr_on();
 }
+
+// Lock statistics, summed over all the locks of each name, most
+// contended first. One line per name:
+//   name kind locks acquires contended spins sleeps waitcycles maxhold
+#define NLOCKNAME 48
+
+static struct lockstat byname[NLOCKNAME];
+static int nlocks[NLOCKNAME];
+
+// Write the statistics as text into buf; returns the length.
+int
+statslock(char *buf, int sz)
+{
+  struct lockstat *st, *b, t;
+  int i, j, n = 0, off;
+
+  acquire(&locklist.lock);
+  for(st = locklist.head; st; st = st->next){
+    for(i = 0; i < n; i++)
+      if(byname[i].sleep == st->sleep && strncmp(byname[i].name, st->name, 32) == 0)
+        break;
+    if(i == n){
+      if(n == NLOCKNAME)
+        continue;
+      memset(&byname[n], 0, sizeof(byname[n]));
+      byname[n].name = st->name;
+      byname[n].sleep = st->sleep;
+      nlocks[n++] = 0;
+    }
+    b = &byname[i];
+    nlocks[i]++;
+    b->nacquire += st->nacquire;
+    b->ncontended += st->ncontended;
+    b->nspin += st->nspin;
+    b->nsleep += st->nsleep;
+    b->waitcycles += st->waitcycles;
+    if(st->maxhold > b->maxhold)
+      b->maxhold = st->maxhold;
+  }
+
+  // insertion sort, most contended first.
+  for(i = 1; i < n; i++){
+    t = byname[i];
+    int c = nlocks[i];
+    for(j = i; j > 0 && (byname[j-1].ncontended < t.ncontended ||
+        (byname[j-1].ncontended == t.ncontended &&
+         byname[j-1].waitcycles < t.waitcycles)); j--){
+      byname[j] = byname[j-1];
+      nlocks[j] = nlocks[j-1];
+    }
+    byname[j] = t;
+    nlocks[j] = c;
+  }
+
+  off = snprintf(buf, sz, "name kind locks acquires contended spins sleeps waitcycles maxhold\n");
+  for(i = 0; i < n && off < sz; i++){
+    b = &byname[i];
+    off += snprintf(buf+off, sz-off, "%s %s %d %l %l %l %l %l %l\n",
+                    b->name, b->sleep ? "sleep" : "spin", nlocks[i],
+                    b->nacquire, b->ncontended, b->nspin, b->nsleep,
+                    b->waitcycles, b->maxhold);
+  }
+  release(&locklist.lock);
+  return off;
+}
+
+// Zero the counters of every lock.
+void
+lockstatreset(void)
+{
+  struct lockstat *st;
+
+  acquire(&locklist.lock);
+  for(st = locklist.head; st; st = st->next){
+    st->nacquire = 0;
+    st->ncontended = 0;
+    st->nspin = 0;
+    st->nsleep = 0;
+    st->waitcycles = 0;
+    st->maxhold = 0;
+  }
+  release(&locklist.lock);
+}
@@ -1,9 +1,28 @@
+// Contention statistics, kept for every spinlock and sleeplock
+// and read through the statistics device (see statslock()).
+struct lockstat {
+  char *name;        // Name of lock.
+  int sleep;         // Is this a sleeplock's?
+  uint64 nacquire;   // Times acquired
+  uint64 ncontended; // ... of which had to wait
+  uint64 nspin;      // Times round a spin loop waiting
+  uint64 nsleep;     // Acquires that had to sleep (sleeplocks)
+  uint64 waitcycles; // rdtime cycles spent waiting
+  uint64 maxhold;    // Longest time held, in rdtime cycles
+  uint64 t0;         // When the current holder got it
+  struct lockstat *next, *prev;  // In the list of all locks
+};
+
 // Mutual exclusion lock.
 struct spinlock {
-  uint locked;       // Is the lock held?
+  uint locked;       // Is the lock held? (test-and-set lock)
+  uint next;         // Next ticket to hand out (ticket lock)
+  uint owner;        // Ticket now allowed in (ticket lock)
 
   // For debugging:
   char *name;        // Name of lock.
   struct cpu *cpu;   // The cpu holding the lock.
-};
 
+  // Statistics, updated by the holder:
+  struct lockstat stat;
+};
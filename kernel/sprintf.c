@@ -0,0 +1,99 @@
+//
+// formatted output to a buffer -- snprintf.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+static char digits[] = "0123456789abcdef";
+
+static int
+sputc(char *s, int sz, int off, char c)
+{
+  if(off < sz)
+    s[off] = c;
+  return off + 1;
+}
+
+static int
+sprintint(char *s, int sz, int off, uint64 x, int base, int sign)
+{
+  char buf[24];
+  int i;
+
+  if(sign && (sign = (long)x < 0))
+    x = -x;
+
+  i = 0;
+  do {
+    buf[i++] = digits[x % base];
+  } while((x /= base) != 0);
+
+  if(sign)
+    buf[i++] = '-';
+
+  while(--i >= 0)
+    off = sputc(s, sz, off, buf[i]);
+  return off;
+}
+
+// Format into buf, writing at most sz bytes and no terminating
+// 0. Understands %d, %x, %s, and %l for a uint64 in decimal.
+// Returns the number of bytes written.
+int
+snprintf(char *buf, int sz, char *fmt, ...)
+{
+  va_list ap;
+  int i, c;
+  int off = 0;
+  char *s;
+
+  if (fmt == 0)
+    panic("null fmt");
+
+  va_start(ap, fmt);
+  for(i = 0; off < sz && (c = fmt[i] & 0xff) != 0; i++){
+    if(c != '%'){
+      off = sputc(buf, sz, off, c);
+      continue;
+    }
+    c = fmt[++i] & 0xff;
+    if(c == 0)
+      break;
+    switch(c){
+    case 'd':
+      off = sprintint(buf, sz, off, va_arg(ap, int), 10, 1);
+      break;
+    case 'x':
+      off = sprintint(buf, sz, off, va_arg(ap, uint), 16, 0);
+      break;
+    case 'l':
+      off = sprintint(buf, sz, off, va_arg(ap, uint64), 10, 0);
+      break;
+    case 's':
+      if((s = va_arg(ap, char*)) == 0)
+        s = "(null)";
+      for(; *s; s++)
+        off = sputc(buf, sz, off, *s);
+      break;
+    case '%':
+      off = sputc(buf, sz, off, '%');
+      break;
+    default:
+      // Print unknown % sequence to draw attention.
+      off = sputc(buf, sz, off, '%');
+      off = sputc(buf, sz, off, c);
+      break;
+    }
+  }
+  va_end(ap);
+  return off < sz ? off : sz;
+}
@@ -0,0 +1,64 @@
+//
+// The statistics device: reading it returns a snapshot of the
+// lock statistics as text (see statslock() in spinlock.c);
+// writing anything to it zeroes the counters.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define BUFSZ 4096
+static struct {
+  struct spinlock lock;
+  char buf[BUFSZ];
+  int sz;
+} stats;
+
+int
+statswrite(int user_src, uint64 src, int n)
+{
+  lockstatreset();
+  return n;
+}
+
+// A read at file offset 0 takes a new snapshot; reads at
+// later offsets go on through the latest one, and return 0
+// past its end.
+int
+statsread(int user_dst, uint64 dst, int n, uint off)
+{
+  int m;
+
+  acquire(&stats.lock);
+  if(off == 0)
+    stats.sz = statslock(stats.buf, BUFSZ);
+  m = 0;
+  if(off < stats.sz){
+    m = stats.sz - off;
+    if(m > n)
+      m = n;
+    if(either_copyout(user_dst, dst, stats.buf+off, m) == -1){
+      release(&stats.lock);
+      return -1;
+    }
+  }
+  release(&stats.lock);
+  return m;
+}
+
+void
+statsinit(void)
+{
+  initlock(&stats.lock, "stats");
+
+  devsw[STATS].read = statsread;
+  devsw[STATS].write = statswrite;
+}
@@ -3,6 +3,7 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "syscall.h"
 #include "defs.h"
@@ -93,6 +94,20 @@ extern uint64 sys_write(void);
 extern uint64 sys_uptime(void);
 extern uint64 sys_trace(void);
 extern uint64 sys_sysinfo(void);
+extern uint64 sys_sched_setaffinity(void);
+extern uint64 sys_sched_getaffinity(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex_wait(void);
+extern uint64 sys_futex_wake(void);
+extern uint64 sys_sigalarm(void);
+extern uint64 sys_sigreturn(void);
+extern uint64 sys_getrusage(void);
+extern uint64 sys_pstat(void);
+extern uint64 sys_rtsched(void);
+extern uint64 sys_rtwait(void);
+extern uint64 sys_diskpoll(void);
+extern uint64 sys_crash(void);
 
 // 输入 void，输出 uint64 的函数指针的数组 syscalls
 // static 声明表示这是全局变量
@@ -105,6 +120,14 @@ static uint64 (*syscalls[])(void) = {
     [SYS_write] sys_write, [SYS_mknod] sys_mknod,     [SYS_unlink] sys_unlink,
     [SYS_link] sys_link,   [SYS_mkdir] sys_mkdir,     [SYS_close] sys_close,
     [SYS_trace] sys_trace, [SYS_sysinfo] sys_sysinfo,
+    [SYS_sched_setaffinity] sys_sched_setaffinity,
+    [SYS_sched_getaffinity] sys_sched_getaffinity,
+    [SYS_clone] sys_clone, [SYS_join] sys_join,
+    [SYS_futex_wait] sys_futex_wait, [SYS_futex_wake] sys_futex_wake,
+    [SYS_sigalarm] sys_sigalarm, [SYS_sigreturn] sys_sigreturn,
+    [SYS_getrusage] sys_getrusage, [SYS_pstat] sys_pstat,
+    [SYS_rtsched] sys_rtsched, [SYS_rtwait] sys_rtwait,
+    [SYS_diskpoll] sys_diskpoll, [SYS_crash] sys_crash,
 };
 
 static char *syscalls_name[] = {
@@ -116,6 +139,14 @@ static char *syscalls_name[] = {
     [SYS_write] "write", [SYS_mknod] "mknod",       [SYS_unlink] "unlink",
     [SYS_link] "link",   [SYS_mkdir] "mkdir",       [SYS_close] "close",
     [SYS_trace] "trace", [SYS_sysinfo] "sysinfo",
+    [SYS_sched_setaffinity] "sched_setaffinity",
+    [SYS_sched_getaffinity] "sched_getaffinity",
+    [SYS_clone] "clone", [SYS_join] "join",
+    [SYS_futex_wait] "futex_wait", [SYS_futex_wake] "futex_wake",
+    [SYS_sigalarm] "sigalarm", [SYS_sigreturn] "sigreturn",
+    [SYS_getrusage] "getrusage", [SYS_pstat] "pstat",
+    [SYS_rtsched] "rtsched", [SYS_rtwait] "rtwait",
+    [SYS_diskpoll] "diskpoll", [SYS_crash] "crash",
 };
 
 void syscall(void) {
@@ -123,6 +154,7 @@ void syscall(void) {
   struct proc *p = myproc();
 
   num = p->trapframe->a7;
+  p->ru.nsyscall++;
   if (num > 0 && num < NELEM(syscalls) && syscalls[num]) {
     p->trapframe->a0 = syscalls[num]();
 
@@ -22,3 +22,17 @@
 #define SYS_close 21
 #define SYS_trace 22
 #define SYS_sysinfo 23
+#define SYS_sched_setaffinity 24
+#define SYS_sched_getaffinity 25
+#define SYS_clone 26
+#define SYS_join 27
+#define SYS_futex_wait 28
+#define SYS_futex_wake 29
+#define SYS_sigalarm 30
+#define SYS_sigreturn 31
+#define SYS_getrusage 32
+#define SYS_pstat 33
+#define SYS_rtsched 34
+#define SYS_rtwait 35
+#define SYS_diskpoll 36
+#define SYS_crash 37
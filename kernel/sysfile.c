@@ -10,28 +10,39 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "fs.h"
-#include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
+// Takes a reference to the file, so that another thread closing the
+// descriptor can't free it; the caller drops it with fileclose().
 static int
 argfd(int n, int *pfd, struct file **pf)
 {
   int fd;
   struct file *f;
+  struct proc *l = myproc()->leader;
 
   if(argint(n, &fd) < 0)
     return -1;
-  if(fd < 0 || fd >= NOFILE || (f=myproc()->ofile[fd]) == 0)
+  if(fd < 0 || fd >= NOFILE)
+    return -1;
+  acquire(&l->filelock);
+  if((f = l->ofile[fd]) != 0)
+    filedup(f);
+  release(&l->filelock);
+  if(f == 0)
     return -1;
   if(pfd)
     *pfd = fd;
   if(pf)
     *pf = f;
+  else
+    fileclose(f);
   return 0;
 }
 
@@ -41,17 +52,36 @@ static int
 fdalloc(struct file *f)
 {
   int fd;
-  struct proc *p = myproc();
+  struct proc *l = myproc()->leader;
 
+  acquire(&l->filelock);
   for(fd = 0; fd < NOFILE; fd++){
-    if(p->ofile[fd] == 0){
-      p->ofile[fd] = f;
+    if(l->ofile[fd] == 0){
+      l->ofile[fd] = f;
+      release(&l->filelock);
       return fd;
     }
   }
+  release(&l->filelock);
   return -1;
 }
 
+// Undo fdalloc(): take f out of slot fd, unless another thread
+// has closed fd meanwhile, in which case that thread has dropped
+// the slot's reference. Returns whether the caller should drop it.
+static int
+fdfree(int fd, struct file *f)
+{
+  struct proc *l = myproc()->leader;
+  int ours;
+
+  acquire(&l->filelock);
+  if((ours = (l->ofile[fd] == f)) != 0)
+    l->ofile[fd] = 0;
+  release(&l->filelock);
+  return ours;
+}
+
 uint64
 sys_dup(void)
 {
@@ -60,9 +90,10 @@ sys_dup(void)
 
   if(argfd(0, 0, &f) < 0)
     return -1;
-  if((fd=fdalloc(f)) < 0)
+  if((fd=fdalloc(f)) < 0){  // takes over argfd's reference
+    fileclose(f);
     return -1;
-  filedup(f);
+  }
   return fd;
 }
 
@@ -70,36 +101,47 @@ uint64
 sys_read(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return fileread(f, p, n);
+  r = fileread(f, p, n);
+  fileclose(f);
+  return r;
 }
 
 uint64
 sys_write(void)
 {
   struct file *f;
-  int n;
+  int n, r;
   uint64 p;
 
-  if(argfd(0, 0, &f) < 0 || argint(2, &n) < 0 || argaddr(1, &p) < 0)
+  if(argint(2, &n) < 0 || argaddr(1, &p) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-
-  return filewrite(f, p, n);
+  r = filewrite(f, p, n);
+  fileclose(f);
+  return r;
 }
 
+// Test and clear the descriptor's slot under filelock, so that
+// of two threads closing it only one gets the file to drop.
 uint64
 sys_close(void)
 {
   int fd;
   struct file *f;
+  struct proc *l = myproc()->leader;
 
-  if(argfd(0, &fd, &f) < 0)
+  if(argint(0, &fd) < 0 || fd < 0 || fd >= NOFILE)
+    return -1;
+  acquire(&l->filelock);
+  if((f = l->ofile[fd]) != 0)
+    l->ofile[fd] = 0;
+  release(&l->filelock);
+  if(f == 0)
     return -1;
-  myproc()->ofile[fd] = 0;
   fileclose(f);
   return 0;
 }
@@ -109,10 +151,13 @@ sys_fstat(void)
 {
   struct file *f;
   uint64 st; // user pointer to struct stat
+  int r;
 
-  if(argfd(0, 0, &f) < 0 || argaddr(1, &st) < 0)
+  if(argaddr(1, &st) < 0 || argfd(0, 0, &f) < 0)
     return -1;
-  return filestat(f, st);
+  r = filestat(f, st);
+  fileclose(f);
+  return r;
 }
 
 // Create the path new as a link to the same inode as old.
@@ -335,8 +380,8 @@ sys_open(void)
     f->major = ip->major;
   } else {
     f->type = FD_INODE;
-    f->off = 0;
   }
+  f->off = 0;
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
   f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
@@ -391,7 +436,7 @@ uint64
 sys_chdir(void)
 {
   char path[MAXPATH];
-  struct inode *ip;
+  struct inode *ip, *old;
   struct proc *p = myproc();
   
   begin_op();
@@ -406,9 +451,12 @@ sys_chdir(void)
     return -1;
   }
   iunlock(ip);
-  iput(p->cwd);
+  acquire(&p->leader->filelock);
+  old = p->leader->cwd;
+  p->leader->cwd = ip;
+  release(&p->leader->filelock);
+  iput(old);
   end_op();
-  p->cwd = ip;
   return 0;
 }
 
@@ -468,18 +516,17 @@ sys_pipe(void)
     return -1;
   fd0 = -1;
   if((fd0 = fdalloc(rf)) < 0 || (fd1 = fdalloc(wf)) < 0){
-    if(fd0 >= 0)
-      p->ofile[fd0] = 0;
-    fileclose(rf);
+    if(fd0 < 0 || fdfree(fd0, rf))
+      fileclose(rf);
     fileclose(wf);
     return -1;
   }
   if(copyout(p->pagetable, fdarray, (char*)&fd0, sizeof(fd0)) < 0 ||
      copyout(p->pagetable, fdarray+sizeof(fd0), (char *)&fd1, sizeof(fd1)) < 0){
-    p->ofile[fd0] = 0;
-    p->ofile[fd1] = 0;
-    fileclose(rf);
-    fileclose(wf);
+    if(fdfree(fd0, rf))
+      fileclose(rf);
+    if(fdfree(fd1, wf))
+      fileclose(wf);
     return -1;
   }
   return 0;
@@ -1,4 +1,9 @@
 struct sysinfo {
   uint64 freemem;   // amount of free memory (bytes)
   uint64 nproc;     // number of process
+  uint64 nbuf;      // buffers in the disk block cache
+  uint64 bhit;      // block reads found in the cache
+  uint64 bmiss;     // block reads that went to disk
+  uint64 ioreq;     // disk requests
+  uint64 iomerge;   // blocks merged into another block's disk request
 };
\ No newline at end of file
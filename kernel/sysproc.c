@@ -5,6 +5,7 @@
 #include "param.h"
 #include "memlayout.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "sysinfo.h"
 
@@ -30,27 +31,15 @@ uint64 sys_sbrk(void) {
   int n;
 
   if (argint(0, &n) < 0) return -1;
-  addr = myproc()->sz;
-  if (growproc(n) < 0) return -1;
+  if ((addr = growproc(n)) < 0) return -1;
   return addr;
 }
 
 uint64 sys_sleep(void) {
   int n;
-  uint ticks0;
 
   if (argint(0, &n) < 0) return -1;
-  acquire(&tickslock);
-  ticks0 = ticks;
-  while (ticks - ticks0 < n) {
-    if (myproc()->killed) {
-      release(&tickslock);
-      return -1;
-    }
-    sleep(&ticks, &tickslock);
-  }
-  release(&tickslock);
-  return 0;
+  return sleepuntil(tickcount() + n);
 }
 
 uint64 sys_kill(void) {
@@ -62,14 +51,7 @@ uint64 sys_kill(void) {
 
 // return how many clock tick interrupts have occurred
 // since start.
-uint64 sys_uptime(void) {
-  uint xticks;
-
-  acquire(&tickslock);
-  xticks = ticks;
-  release(&tickslock);
-  return xticks;
-}
+uint64 sys_uptime(void) { return tickcount(); }
 
 uint64 sys_trace(void) {
   int mask;
@@ -88,19 +70,133 @@ uint64 sys_sysinfo(void) {
   uint64 sysinfo_addr;
   if (argaddr(0, &sysinfo_addr) < 0) return -1;
   struct proc *p = myproc();
+  struct sysinfo info;
 
-  uint64 freemem;
-  freemem = getfreeMemorySize();
-  uint64 nproc;
-  nproc = getProcessUnusedCount();
-  if (copyout(p->pagetable, sysinfo_addr, (char *)&freemem, sizeof(freemem)) <
-      0) {
+  info.freemem = getfreeMemorySize();
+  info.nproc = getProcessUnusedCount();
+  bstat(&info.nbuf, &info.bhit, &info.bmiss);
+  iostat(&info.ioreq, &info.iomerge);
+  if (copyout(p->pagetable, sysinfo_addr, (char *)&info, sizeof(info)) < 0) {
     return -1;
   }
-  if (copyout(p->pagetable, sysinfo_addr + sizeof(freemem), (char *)&nproc,
-              sizeof(nproc)) < 0) {
+
+  return 0;
+}
+
+// set the mask of harts that process pid (0 for the caller) may run on.
+uint64 sys_sched_setaffinity(void) {
+  int pid;
+  uint64 mask;
+
+  if (argint(0, &pid) < 0 || argaddr(1, &mask) < 0) return -1;
+  return setaffinity(pid, mask);
+}
+
+// copy the hart mask of process pid (0 for the caller) out to user space.
+uint64 sys_sched_getaffinity(void) {
+  int pid;
+  uint64 addr, mask;
+
+  if (argint(0, &pid) < 0 || argaddr(1, &addr) < 0) return -1;
+  if (getaffinity(pid, &mask) < 0) return -1;
+  if (copyout(myproc()->pagetable, addr, (char *)&mask, sizeof(mask)) < 0)
     return -1;
-  };
+  return 0;
+}
+
+// start a thread at fn(arg) on the user stack whose top is stack.
+uint64 sys_clone(void) {
+  uint64 fn, arg, stack;
+
+  if (argaddr(0, &fn) < 0 || argaddr(1, &arg) < 0 || argaddr(2, &stack) < 0)
+    return -1;
+  return clone(fn, arg, stack);
+}
+
+uint64 sys_join(void) {
+  int tid;
+  uint64 addr;
 
+  if (argint(0, &tid) < 0 || argaddr(1, &addr) < 0) return -1;
+  return join(tid, addr);
+}
+
+// sleep while the int at addr equals val.
+uint64 sys_futex_wait(void) {
+  uint64 addr;
+  int val;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &val) < 0) return -1;
+  return futexwait(addr, val);
+}
+
+// wake up to n waiters on the int at addr.
+uint64 sys_futex_wake(void) {
+  uint64 addr;
+  int n;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &n) < 0) return -1;
+  return futexwake(addr, n);
+}
+
+// call handler every interval ticks of CPU time; 0 turns it off.
+uint64 sys_sigalarm(void) {
+  int interval;
+  uint64 handler;
+  struct proc *p = myproc();
+
+  if (argint(0, &interval) < 0 || argaddr(1, &handler) < 0) return -1;
+  if (interval < 0) return -1;
+  p->alarm_interval = interval;
+  p->alarm_handler = handler;
+  p->alarm_ticks = 0;
   return 0;
 }
+
+// return from a sigalarm() handler.
+uint64 sys_sigreturn(void) { return alarmreturn(); }
+
+uint64 sys_getrusage(void) {
+  int pid;
+  uint64 addr;
+
+  if (argint(0, &pid) < 0 || argaddr(1, &addr) < 0) return -1;
+  return getrusage(pid, addr);
+}
+
+uint64 sys_pstat(void) {
+  uint64 addr;
+  int n;
+
+  if (argaddr(0, &addr) < 0 || argint(1, &n) < 0) return -1;
+  return pstat(addr, n);
+}
+
+uint64 sys_rtsched(void) {
+  int period, budget;
+
+  if (argint(0, &period) < 0 || argint(1, &budget) < 0) return -1;
+  return rtsched(period, budget);
+}
+
+uint64 sys_rtwait(void) { return rtwait(); }
+
+// set how many cycles a wait for the disk may poll before it
+// sleeps (0 for never); a negative n leaves it as it is.
+// returns the old setting.
+uint64 sys_diskpoll(void) {
+  int n;
+
+  if (argint(0, &n) < 0) return -1;
+  return virtio_disk_poll(n);
+}
+
+// power off in the middle of the next commit, at the given
+// point of the log protocol (see log.c), to test recovery.
+// fails unless the kernel was built with CRASHTEST.
+uint64 sys_crash(void) {
+  int point;
+
+  if (argint(0, &point) < 0) return -1;
+  return logcrash(point);
+}
@@ -3,23 +3,43 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "sleeplock.h"
 #include "proc.h"
 #include "defs.h"
+#include "sigframe.h"
 
-struct spinlock tickslock;
+// mtime / TICKINTERVAL as of the last tickupdate(). written
+// with an atomic compare-and-swap and read with an atomic load,
+// so neither clockintr() nor uptime() takes a lock for it.
 uint ticks;
 
+// a process sleeping in sleepuntil(); lives on its kernel stack.
+struct timer {
+  uint when;            // tick to wake up at
+  struct proc *proc;
+  int fired;
+  struct timer *next;
+};
+
+static struct {
+  struct spinlock lock;
+  struct timer *head;   // earliest first
+  uint64 next;          // mtime when head is due, or -1; read without the lock
+} timers;
+
 extern char trampoline[], uservec[], userret[];
 
 // in kernelvec.S, calls kerneltrap().
 void kernelvec();
 
 extern int devintr();
+static void alarmupcall(struct proc *);
 
 void
 trapinit(void)
 {
-  initlock(&tickslock, "time");
+  initlock(&timers.lock, "timers");
+  timers.next = -1;
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -68,6 +88,8 @@ usertrap(void)
   } else if((which_dev = devintr()) != 0){
     // ok
   } else {
+    if(r_scause() == 12 || r_scause() == 13 || r_scause() == 15)
+      p->ru.nfault++;  // instruction, load or store page fault
     printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
     printf("            sepc=%p stval=%p\n", r_sepc(), r_stval());
     p->killed = 1;
@@ -76,13 +98,75 @@ usertrap(void)
   if(p->killed)
     exit(-1);
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2)
+  // give up the CPU if this is a timer interrupt. a kick
+  // is not a tick, so it isn't charged.
+  if(which_dev == 2){
+    p->ru.utime++;
+    p->alarm_ticks++;
+    p->rt_used++;
     yield();
+  } else if(which_dev == 3){
+    yield();
+  }
+
+  if(p->alarm_interval && p->alarm_frame == 0 &&
+     p->alarm_ticks >= p->alarm_interval){
+    p->alarm_ticks = 0;
+    alarmupcall(p);
+  }
 
   usertrapret();
 }
 
+// push p's user registers on its user stack as a struct sigframe
+// and arrange for the return to user space to enter the sigalarm()
+// handler, with the frame's address in a0, running on the stack
+// just below it. sigreturn() resumes from the frame.
+static void
+alarmupcall(struct proc *p)
+{
+  struct trapframe *tf = p->trapframe;
+  struct sigframe frame;
+  uint64 sp;
+
+  frame.epc = tf->epc;
+  memmove(&frame.ra, &tf->ra, sizeof(frame) - sizeof(frame.epc));
+  sp = (tf->sp - sizeof(frame)) & ~0xfUL;
+  if(copyout(p->pagetable, sp, (char*)&frame, sizeof(frame)) < 0){
+    printf("pid %d %s: bad stack for sigalarm handler\n", p->pid, p->name);
+    p->killed = 1;
+    return;
+  }
+
+  p->alarm_frame = sp;
+  tf->epc = p->alarm_handler;
+  tf->a0 = sp;
+  tf->sp = sp;
+  tf->ra = 0;  // the handler must call sigreturn().
+}
+
+// resume from the sigframe that alarmupcall() pushed, as the
+// handler may have changed it. returns the restored a0, so that
+// the system call return leaves it in place.
+uint64
+alarmreturn(void)
+{
+  struct proc *p = myproc();
+  struct trapframe *tf = p->trapframe;
+  struct sigframe frame;
+
+  if(p->alarm_frame == 0)
+    return -1;
+  if(copyin(p->pagetable, (char*)&frame, p->alarm_frame, sizeof(frame)) < 0){
+    p->killed = 1;
+    return -1;
+  }
+  tf->epc = frame.epc;
+  memmove(&tf->ra, &frame.ra, sizeof(frame) - sizeof(frame.epc));
+  p->alarm_frame = 0;
+  return tf->a0;
+}
+
 //
 // return to user space
 //
@@ -102,7 +186,7 @@ usertrapret(void)
   // set up trapframe values that uservec will need when
   // the process next re-enters the kernel.
   p->trapframe->kernel_satp = r_satp();         // kernel page table
-  p->trapframe->kernel_sp = p->kstack + PGSIZE; // process's kernel stack
+  p->trapframe->kernel_sp = p->kstack + KSTACKSIZE; // process's kernel stack
   p->trapframe->kernel_trap = (uint64)usertrap;
   p->trapframe->kernel_hartid = r_tp();         // hartid for cpuid()
 
@@ -125,7 +209,7 @@ usertrapret(void)
   // switches to the user page table, restores user registers,
   // and switches to user mode with sret.
   uint64 fn = TRAMPOLINE + (userret - trampoline);
-  ((void (*)(uint64,uint64))fn)(TRAPFRAME, satp);
+  ((void (*)(uint64,uint64))fn)(p->tfva, satp);
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -149,9 +233,16 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
-  if(which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
+  // give up the CPU if this is a timer interrupt or a kick.
+  if((which_dev == 2 || which_dev == 3) &&
+     myproc() != 0 && myproc()->state == RUNNING){
+    if(which_dev == 2){
+      myproc()->ru.stime++;
+      myproc()->alarm_ticks++;
+      myproc()->rt_used++;
+    }
     yield();
+  }
 
   // the yield() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -159,18 +250,142 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// set timers.next from the head of the list.
+// caller must hold timers.lock.
+static void
+timersnext(void)
+{
+  uint64 next = timers.head ? (uint64)timers.head->when * TICKINTERVAL : -1;
+
+  __atomic_store_n(&timers.next, next, __ATOMIC_RELEASE);
+}
+
+// wake the sleepers whose timers are due at tick now.
+static void
+timersfire(uint now)
+{
+  struct timer *t;
+  uint64 rt = 0;
+
+  acquire(&timers.lock);
+  while((t = timers.head) != 0 && (int)(now - t->when) >= 0){
+    timers.head = t->next;
+    t->fired = 1;
+    if(t->proc->rt_period)
+      rt |= t->proc->affinity;
+    // t stays put until we release timers.lock,
+    // which its sleeper needs to return.
+    wakeupproc(t->proc, t);
+  }
+  timersnext();
+  release(&timers.lock);
+  if(rt)
+    kickrt(rt);
+}
+
+// bring ticks up to date with the CLINT's mtime, and fire any
+// timers that are due. takes timers.lock only when one is.
+// ticks may lag behind when every hart has stopped its tick.
+void
+tickupdate(void)
+{
+  uint64 mtime = *(uint64*)CLINT_MTIME;
+  uint now = mtime / TICKINTERVAL;
+  uint old = __atomic_load_n(&ticks, __ATOMIC_RELAXED);
+
+  // another hart may be storing an older value; never go back.
+  while((int)(now - old) > 0 &&
+        !__atomic_compare_exchange_n(&ticks, &old, now, 0,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    ;
+  if(mtime >= __atomic_load_n(&timers.next, __ATOMIC_ACQUIRE))
+    timersfire(now);
+}
+
+// the current tick, without a lock.
+uint
+tickcount(void)
+{
+  tickupdate();
+  return __atomic_load_n(&ticks, __ATOMIC_RELAXED);
+}
+
+// sleep until ticks reaches when. returns 0,
+// or -1 if the process was killed first.
+int
+sleepuntil(uint when)
+{
+  struct timer t, **tp;
+  struct proc *p = myproc();
+
+  if((int)(tickcount() - when) >= 0)
+    return 0;
+
+  t.when = when;
+  t.proc = p;
+  t.fired = 0;
+  acquire(&timers.lock);
+  for(tp = &timers.head; *tp && (int)((*tp)->when - when) <= 0; tp = &(*tp)->next)
+    ;
+  t.next = *tp;
+  *tp = &t;
+  timersnext();
+  // if when has come already, this hart is still ticking, or
+  // arms its timer for timers.next before it idles, so the next
+  // clockintr() fires t.
+  while(!t.fired && !p->killed)
+    sleep(&t, &timers.lock);
+  if(!t.fired){
+    for(tp = &timers.head; *tp; tp = &(*tp)->next){
+      if(*tp == &t){
+        *tp = t.next;
+        break;
+      }
+    }
+    timersnext();
+  }
+  release(&timers.lock);
+  return t.fired ? 0 : -1;
+}
+
+// the mtime at which an idle hart must next take a timer
+// interrupt, or -1 if nothing is waiting for the clock.
+// reads timers.next without the lock; a sleeper that
+// races with this is on a hart that is still ticking.
+uint64
+timernext(void)
+{
+  return __atomic_load_n(&timers.next, __ATOMIC_ACQUIRE);
+}
+
+// program this hart's next timer interrupt for mtime when.
+void
+timerset(uint64 when)
+{
+  mycpu()->deadline = when;
+  *(uint64*)CLINT_MTIMECMP(cpuid()) = when;
+}
+
+// make hart id take a timer interrupt right away,
+// to get it out of wfi or off its process. leaves
+// cpus[id].deadline alone, so devintr() can tell
+// the kick from the deadline.
+void
+timerkick(int id)
+{
+  *(uint64*)CLINT_MTIMECMP(id) = 0;
+}
+
 void
 clockintr()
 {
-  acquire(&tickslock);
-  ticks++;
-  wakeup(&ticks);
-  release(&tickslock);
+  tickupdate();
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
+// 3 if timerkick(),
 // 1 if other device,
 // 0 if not recognized.
 int
@@ -202,17 +417,30 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000001L){
     // software interrupt from a machine-mode timer interrupt,
-    // forwarded by timervec in kernelvec.S.
-
-    if(cpuid() == 0){
-      clockintr();
+    // forwarded by timervec in kernelvec.S, which has disarmed
+    // the timer. any hart may advance ticks.
+    struct cpu *c = mycpu();
+    uint64 now = *(uint64*)CLINT_MTIME;
+    int kick = now < c->deadline;
+
+    c->ntimer++;
+    clockintr();
+
+    // keep a preemption tick while running a process. in the
+    // scheduler, with TICKLESS, scheduler() decides for itself
+    // whether to tick or to wait for the next deadline. a kick
+    // leaves the tick it cut short where it was.
+    c->ticking = 0;
+    if(c->proc != 0 || !TICKLESS){
+      timerset(kick ? c->deadline : now + TICKINTERVAL);
+      c->ticking = 1;
     }
     
     // acknowledge the software interrupt by clearing
     // the SSIP bit in sip.
     w_sip(r_sip() & ~2);
 
-    return 2;
+    return kick ? 3 : 2;
   } else {
     return 0;
   }
@@ -37,15 +37,17 @@
 // device feature bits
 #define VIRTIO_BLK_F_RO              5	/* Disk is read-only */
 #define VIRTIO_BLK_F_SCSI            7	/* Supports scsi command passthru */
+#define VIRTIO_BLK_F_FLUSH           9	/* Cache flush command support */
 #define VIRTIO_BLK_F_CONFIG_WCE     11	/* Writeback mode available in config */
 #define VIRTIO_BLK_F_MQ             12	/* support more than one vq */
 #define VIRTIO_F_ANY_LAYOUT         27
 #define VIRTIO_RING_F_INDIRECT_DESC 28
 #define VIRTIO_RING_F_EVENT_IDX     29
 
-// this many virtio descriptors.
+// at most this many virtio descriptors, fewer if the
+// device's queue is shorter.
 // must be a power of two.
-#define NUM 8
+#define NUM 128
 
 struct VRingDesc {
   uint64 addr;
@@ -55,6 +57,7 @@ struct VRingDesc {
 };
 #define VRING_DESC_F_NEXT  1 // chained with another descriptor
 #define VRING_DESC_F_WRITE 2 // device writes (vs read)
+#define VRING_DESC_F_INDIRECT 4 // buffer holds a table of descriptors
 
 struct VRingUsedElem {
   uint32 id;   // index of start of completed descriptor chain
@@ -64,6 +67,7 @@ struct VRingUsedElem {
 // for disk ops
 #define VIRTIO_BLK_T_IN  0 // read the disk
 #define VIRTIO_BLK_T_OUT 1 // write the disk
+#define VIRTIO_BLK_T_FLUSH 4 // make finished writes durable
 
 struct UsedArea {
   uint16 flags;
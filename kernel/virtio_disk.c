@@ -20,6 +20,12 @@
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
 
+struct virtio_blk_outhdr {
+  uint32 type;
+  uint32 reserved;
+  uint64 sector;
+};
+
 static struct disk {
  // memory for virtio descriptors &c for queue 0.
  // this is a global instead of allocated because it must
@@ -31,16 +37,30 @@ static struct disk {
   struct UsedArea *used;
 
   // our own book-keeping.
+  int num;         // descriptors in the queue, at most NUM.
+  int poll;        // cycles virtio_disk_wait() polls; see there.
+  int indirect;    // VIRTIO_RING_F_INDIRECT_DESC negotiated?
+  int flush;       // VIRTIO_BLK_F_FLUSH negotiated, so writes are cached?
   char free[NUM];  // is a descriptor free?
-  uint16 used_idx; // we've looked this far in used[2..NUM].
+  uint16 used_idx; // we've looked this far in used[2..num].
 
   // track info about in-flight operations,
   // for use when completion interrupt arrives.
   // indexed by first descriptor index of chain.
   struct {
-    struct buf *b;
+    struct buf *b;   // the first buf; the rest follow through qnext
     char status;
+    char flushing;   // a flush, which virtio_disk_flush() waits for
   } info[NUM];
+
+  // the type/reserved/sector header of each chain,
+  // indexed like info.
+  struct virtio_blk_outhdr ops[NUM];
+
+  // with indirect descriptors, each chain lives in its own
+  // table, so that a request takes one ring descriptor however
+  // many blocks it moves. indexed like info.
+  struct VRingDesc itab[NUM][MAXSEG+2];
   
   struct spinlock vdisk_lock;
   
@@ -52,6 +72,7 @@ virtio_disk_init(void)
   uint32 status = 0;
 
   initlock(&disk.vdisk_lock, "virtio_disk");
+  disk.poll = DISKPOLL;
 
   if(*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
      *R(VIRTIO_MMIO_VERSION) != 1 ||
@@ -74,8 +95,11 @@ virtio_disk_init(void)
   features &= ~(1 << VIRTIO_BLK_F_MQ);
   features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
   features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
-  features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
   *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+  disk.indirect = (features >> VIRTIO_RING_F_INDIRECT_DESC) & 1;
+  // with VIRTIO_BLK_F_FLUSH, qemu caches writes, and a finished
+  // write isn't durable until a flush; see virtio_disk_flush().
+  disk.flush = (features >> VIRTIO_BLK_F_FLUSH) & 1;
 
   // tell device that feature negotiation is complete.
   status |= VIRTIO_CONFIG_S_FEATURES_OK;
@@ -92,21 +116,26 @@ virtio_disk_init(void)
   uint32 max = *R(VIRTIO_MMIO_QUEUE_NUM_MAX);
   if(max == 0)
     panic("virtio disk has no queue 0");
-  if(max < NUM)
-    panic("virtio disk max queue too short");
-  *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+  // as many descriptors as both we and the device can take;
+  // both are powers of two.
+  disk.num = max < NUM ? max : NUM;
+  *R(VIRTIO_MMIO_QUEUE_NUM) = disk.num;
   memset(disk.pages, 0, sizeof(disk.pages));
   *R(VIRTIO_MMIO_QUEUE_PFN) = ((uint64)disk.pages) >> PGSHIFT;
 
   // desc = pages -- num * VRingDesc
-  // avail = pages + 0x40 -- 2 * uint16, then num * uint16
+  // avail = pages + num * 16 -- 2 * uint16, then num * uint16
   // used = pages + 4096 -- 2 * uint16, then num * vRingUsedElem
 
+  if(NUM*sizeof(struct VRingDesc) + (NUM+3)*sizeof(uint16) > PGSIZE)
+    panic("virtio disk NUM too big");
+  if(!disk.indirect && disk.num < MAXSEG+2)
+    panic("virtio disk queue too short");
   disk.desc = (struct VRingDesc *) disk.pages;
-  disk.avail = (uint16*)(((char*)disk.desc) + NUM*sizeof(struct VRingDesc));
+  disk.avail = (uint16*)(((char*)disk.desc) + disk.num*sizeof(struct VRingDesc));
   disk.used = (struct UsedArea *) (disk.pages + PGSIZE);
 
-  for(int i = 0; i < NUM; i++)
+  for(int i = 0; i < disk.num; i++)
     disk.free[i] = 1;
 
   // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
@@ -116,7 +145,7 @@ virtio_disk_init(void)
 static int
 alloc_desc()
 {
-  for(int i = 0; i < NUM; i++){
+  for(int i = 0; i < disk.num; i++){
     if(disk.free[i]){
       disk.free[i] = 0;
       return i;
@@ -129,7 +158,7 @@ alloc_desc()
 static void
 free_desc(int i)
 {
-  if(i >= NUM)
+  if(i >= disk.num)
     panic("virtio_disk_intr 1");
   if(disk.free[i])
     panic("virtio_disk_intr 2");
@@ -151,10 +180,12 @@ free_chain(int i)
   }
 }
 
+// allocate n descriptors (they need not be contiguous).
+// disk requests need at least three.
 static int
-alloc3_desc(int *idx)
+allocn_desc(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -165,106 +196,224 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// queue one request of the given type for the n locked buffers
+// b, b->qnext, ..., whose blocks follow one another on disk,
+// and tell the device; return the request's head descriptor.
+// a flush has no buffers. waits if the queue is full.
+// caller holds disk.vdisk_lock.
+//
+// the spec says that legacy block operations use one
+// descriptor for type/reserved/sector, then one for each
+// piece of the data, then one for a 1-byte status result.
+// with indirect descriptors, that chain goes in disk.itab[head],
+// and the ring gets one descriptor, head, pointing at it.
+static int
+submit(struct buf *b, int n, int type)
 {
-  uint64 sector = b->blockno * (BSIZE / 512);
-
-  acquire(&disk.vdisk_lock);
+  uint64 sector = b ? b->blockno * (BSIZE / 512) : 0;
+  int idx[MAXSEG+2], head;
+  struct VRingDesc *d;
+  struct buf *bp;
 
-  // the spec says that legacy block operations use three
-  // descriptors: one for type/reserved/sector, one for
-  // the data, one for a 1-byte status result.
+  if(n < 0 || n > MAXSEG)
+    panic("virtio_disk_submit");
 
-  // allocate the three descriptors.
-  int idx[3];
+  // allocate the descriptors.
   while(1){
-    if(alloc3_desc(idx) == 0) {
+    if(allocn_desc(idx, disk.indirect ? 1 : n+2) == 0) {
       break;
     }
     sleep(&disk.free[0], &disk.vdisk_lock);
   }
+  head = idx[0];
+  if(disk.indirect){
+    d = disk.itab[head];
+    for(int i = 0; i < n+2; i++)
+      idx[i] = i;
+  } else {
+    d = disk.desc;
+  }
   
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
-  struct virtio_blk_outhdr {
-    uint32 type;
-    uint32 reserved;
-    uint64 sector;
-  } buf0;
-
-  if(write)
-    buf0.type = VIRTIO_BLK_T_OUT; // write the disk
-  else
-    buf0.type = VIRTIO_BLK_T_IN; // read the disk
-  buf0.reserved = 0;
-  buf0.sector = sector;
-
-  // buf0 is on a kernel stack, which is not direct mapped,
-  // thus the call to kvmpa().
-  disk.desc[idx[0]].addr = (uint64) kvmpa((uint64) &buf0);
-  disk.desc[idx[0]].len = sizeof(buf0);
-  disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-  disk.desc[idx[0]].next = idx[1];
-
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
-
-  disk.info[idx[0]].status = 0;
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
-
-  // record struct buf for virtio_disk_intr().
-  b->disk = 1;
-  disk.info[idx[0]].b = b;
+  struct virtio_blk_outhdr *buf0 = &disk.ops[head];
+
+  buf0->type = type;
+  buf0->reserved = 0;
+  buf0->sector = sector;
+
+  // disk is in kernel memory, which is direct mapped,
+  // unlike a kernel stack.
+  d[idx[0]].addr = (uint64) buf0;
+  d[idx[0]].len = sizeof(*buf0);
+  d[idx[0]].flags = VRING_DESC_F_NEXT;
+  d[idx[0]].next = idx[1];
+
+  bp = b;
+  for(int i = 1; i <= n; i++, bp = bp->qnext){
+    d[idx[i]].addr = (uint64) bp->data;
+    d[idx[i]].len = BSIZE;
+    if(type == VIRTIO_BLK_T_OUT)
+      d[idx[i]].flags = 0; // device reads b->data
+    else
+      d[idx[i]].flags = VRING_DESC_F_WRITE; // device writes b->data
+    d[idx[i]].flags |= VRING_DESC_F_NEXT;
+    d[idx[i]].next = idx[i+1];
+    bp->disk = 1;
+  }
+
+  disk.info[head].status = 0;
+  d[idx[n+1]].addr = (uint64) &disk.info[head].status;
+  d[idx[n+1]].len = 1;
+  d[idx[n+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  d[idx[n+1]].next = 0;
+
+  if(disk.indirect){
+    disk.desc[head].addr = (uint64) d;
+    disk.desc[head].len = (n+2) * sizeof(struct VRingDesc);
+    disk.desc[head].flags = VRING_DESC_F_INDIRECT;
+    disk.desc[head].next = 0;
+  }
+
+  // record the bufs for virtio_disk_intr().
+  disk.info[head].b = b;
+  disk.info[head].flushing = 0;
 
   // avail[0] is flags
   // avail[1] tells the device how far to look in avail[2...].
   // avail[2...] are desc[] indices the device should process.
   // we only tell device the first index in our chain of descriptors.
-  disk.avail[2 + (disk.avail[1] % NUM)] = idx[0];
+  disk.avail[2 + (disk.avail[1] % disk.num)] = head;
   __sync_synchronize();
   disk.avail[1] = disk.avail[1] + 1;
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
 
-  // Wait for virtio_disk_intr() to say request has finished.
-  while(b->disk == 1) {
-    sleep(b, &disk.vdisk_lock);
-  }
+  return head;
+}
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+// queue one request to read or write the n locked buffers
+// b, b->qnext, ..., whose blocks follow one another on disk.
+// when the request is done, virtio_disk_intr() wakes each
+// buffer's waiter, or hands it to breaddone() if b->async.
+void
+virtio_disk_submit(struct buf *b, int n, int write)
+{
+  if(n < 1)
+    panic("virtio_disk_submit");
 
+  acquire(&disk.vdisk_lock);
+  submit(b, n, write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN);
   release(&disk.vdisk_lock);
 }
 
+// make every write the disk has finished durable, and wait
+// until it is. the device doesn't order requests, so a write
+// that must reach the disk before another has to be finished
+// and flushed before the other is started. does nothing if the
+// device writes through, without a cache to flush.
 void
-virtio_disk_intr()
+virtio_disk_flush(void)
 {
+  int head;
+
+  if(!disk.flush)
+    return;
   acquire(&disk.vdisk_lock);
+  head = submit(0, 0, VIRTIO_BLK_T_FLUSH);
+  disk.info[head].flushing = 1;  // before complete() can see it
+  while(disk.info[head].flushing)
+    sleep(&disk.info[head], &disk.vdisk_lock);
+  release(&disk.vdisk_lock);
+}
+
+// finish the requests the device has put in the used ring.
+// caller holds disk.vdisk_lock.
+static void
+complete(void)
+{
+  struct buf *b, *next;
 
-  while((disk.used_idx % NUM) != (disk.used->id % NUM)){
+  while((disk.used_idx % disk.num) != (disk.used->id % disk.num)){
     int id = disk.used->elems[disk.used_idx].id;
 
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
     
-    disk.info[id].b->disk = 0;   // disk is done with buf
-    wakeup(disk.info[id].b);
+    b = disk.info[id].b;
+    disk.info[id].b = 0;
+    if(disk.info[id].flushing){
+      disk.info[id].flushing = 0;
+      wakeup(&disk.info[id]);
+    }
+    free_chain(id);
+    for(; b; b = next){
+      next = b->qnext;
+      b->qnext = 0;
+      b->disk = 0;   // disk is done with buf
+      if(b->async){
+        b->async = 0;
+        breaddone(b);
+      } else {
+        wakeup(b);
+      }
+    }
 
-    disk.used_idx = (disk.used_idx + 1) % NUM;
+    disk.used_idx = (disk.used_idx + 1) % disk.num;
   }
-  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+}
+
+// wait for the disk to finish with b.
+//
+// if disk.poll is set, first watch the used ring for up to that
+// many cycles, since a disk that is quick to answer is done
+// before an interrupt, a wakeup and a context switch would be.
+// only then sleep until the interrupt.
+void
+virtio_disk_wait(struct buf *b)
+{
+  uint64 t0 = r_time();
+
+  acquire(&disk.vdisk_lock);
+  while(b->disk == 1 && r_time() - t0 < disk.poll){
+    if((disk.used_idx % disk.num) != (disk.used->id % disk.num)){
+      complete();
+    } else {
+      release(&disk.vdisk_lock);
+      while(*(volatile uint16 *)&disk.used->id % disk.num ==
+            *(volatile uint16 *)&disk.used_idx &&
+            r_time() - t0 < disk.poll)
+        ;
+      acquire(&disk.vdisk_lock);
+    }
+  }
+  while(b->disk == 1) {
+    sleep(b, &disk.vdisk_lock);
+  }
+  release(&disk.vdisk_lock);
+}
+
+// set disk.poll to cycles, unless cycles is negative;
+// return the old value.
+int
+virtio_disk_poll(int cycles)
+{
+  int old;
+
+  acquire(&disk.vdisk_lock);
+  old = disk.poll;
+  if(cycles >= 0)
+    disk.poll = cycles;
+  release(&disk.vdisk_lock);
+  return old;
+}
 
+void
+virtio_disk_intr()
+{
+  acquire(&disk.vdisk_lock);
+  complete();
+  *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
   release(&disk.vdisk_lock);
 }
@@ -24,6 +24,11 @@ kvminit()
   kernel_pagetable = (pagetable_t) kalloc();
   memset(kernel_pagetable, 0, PGSIZE);
 
+#ifdef CRASHTEST
+  // test device, to power off
+  kvmmap(VIRT_TEST, VIRT_TEST, PGSIZE, PTE_R | PTE_W);
+#endif
+
   // uart registers
   kvmmap(UART0, UART0, PGSIZE, PTE_R | PTE_W);
 
@@ -121,6 +126,45 @@ kvmmap(uint64 va, uint64 pa, uint64 sz, int perm)
     panic("kvmmap");
 }
 
+// create the page-table pages for kernel virtual addresses
+// [va, va+sz), so that kvmmapkstack() never has to allocate.
+// only used when booting.
+void
+kvmprealloc(uint64 va, uint64 sz)
+{
+  uint64 a;
+
+  for(a = PGROUNDDOWN(va); a < va + sz; a += PGSIZE)
+    if(walk(kernel_pagetable, a, 1) == 0)
+      panic("kvmprealloc");
+}
+
+// map a process's kernel stack page at va in the kernel page table,
+// or unmap it. the page-table pages must already exist.
+// does not flush the TLB; the scheduler does that before
+// running a process on a stack that may have moved.
+void
+kvmmapkstack(uint64 va, uint64 pa)
+{
+  pte_t *pte;
+
+  if((pte = walk(kernel_pagetable, va, 0)) == 0)
+    panic("kvmmapkstack");
+  if(*pte & PTE_V)
+    panic("kvmmapkstack: remap");
+  *pte = PA2PTE(pa) | PTE_R | PTE_W | PTE_V;
+}
+
+void
+kvmunmapkstack(uint64 va)
+{
+  pte_t *pte;
+
+  if((pte = walk(kernel_pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+    panic("kvmunmapkstack");
+  *pte = 0;
+}
+
 // translate a kernel virtual address to
 // a physical address. only needed for
 // addresses on the stack.
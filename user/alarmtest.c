@@ -0,0 +1,125 @@
+// Tests sigalarm() and sigreturn(): that the handler runs
+// periodically and the interrupted code resumes intact, and
+// that a handler can switch between green threads by editing
+// the saved frame, i.e. a preemptive user-level scheduler.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/sigframe.h"
+#include "user/user.h"
+
+volatile int count;
+
+void
+periodic(struct sigframe *f)
+{
+  count++;
+  sigreturn();
+}
+
+void
+test0(void)
+{
+  int i, j;
+
+  printf("test0 start\n");
+  count = 0;
+  sigalarm(2, periodic);
+  for(i = 0; i < 1000*500000; i++){
+    if((i % 1000000) == 0)
+      write(2, ".", 1);
+    if(count > 0)
+      break;
+  }
+  sigalarm(0, 0);
+  if(count == 0){
+    printf("\ntest0 failed: the handler never ran\n");
+    exit(1);
+  }
+
+  // registers must survive the upcalls.
+  count = 0;
+  sigalarm(1, periodic);
+  for(j = 0; count < 10; j++)
+    ;
+  sigalarm(0, 0);
+  if(j <= 0){
+    printf("\ntest0 failed: loop counter clobbered\n");
+    exit(1);
+  }
+  printf("\ntest0 passed\n");
+}
+
+// a preemptive scheduler for NGREEN green threads.
+#define NGREEN 3
+#define STACK 4096
+
+struct sigframe frames[NGREEN];
+char stacks[NGREEN][STACK] __attribute__((aligned(16)));
+volatile int progress[NGREEN];
+int current;
+int started;
+
+void
+green(void)
+{
+  int me = current;
+
+  for(;;)
+    progress[me]++;
+}
+
+// the timer upcall: save the running thread's registers and
+// resume the next one instead.
+void
+schedule(struct sigframe *f)
+{
+  int next = (current + 1) % NGREEN;
+
+  frames[current] = *f;
+  if(next != 0 && !(started & (1 << next))){
+    // first run: the same gp and tp, a fresh pc and stack.
+    frames[next] = *f;
+    frames[next].epc = (uint64)green;
+    frames[next].sp = (uint64)(stacks[next] + STACK);
+    frames[next].ra = 0;
+    started |= 1 << next;
+  }
+  current = next;
+  *f = frames[next];
+  sigreturn();
+}
+
+void
+test1(void)
+{
+  int i, t0;
+
+  printf("test1 start\n");
+  current = 0;
+  sigalarm(1, schedule);
+  t0 = uptime();
+  for(;;){
+    progress[0]++;
+    for(i = 1; i < NGREEN; i++)
+      if(progress[i] == 0)
+        break;
+    if(i == NGREEN)
+      break;
+    if(uptime() - t0 > 100){
+      sigalarm(0, 0);
+      printf("test1 failed: green threads never ran\n");
+      exit(1);
+    }
+  }
+  sigalarm(0, 0);
+  printf("test1 passed\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  test0();
+  test1();
+  exit(0);
+}
@@ -0,0 +1,147 @@
+// Parallel reads of different files, to check that the buffer
+// cache's locks are no longer a point of contention: zero the lock
+// statistics, have each process read its own file over and over,
+// then look at how often the bcache locks made anyone wait.
+//
+//   bcachetest [nprocs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define NBLOCK 10   // blocks per file
+#define ROUNDS 100
+#define MAXP   8
+
+char buf[1024];
+char stats[8192];
+
+void
+mkfile(char *name)
+{
+  int fd, i;
+
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "bcachetest: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, name[1], sizeof(buf));
+  for(i = 0; i < NBLOCK; i++){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "bcachetest: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+void
+reader(char *name)
+{
+  int fd, i, j;
+
+  for(i = 0; i < ROUNDS; i++){
+    if((fd = open(name, O_RDONLY)) < 0){
+      fprintf(2, "bcachetest: open %s failed\n", name);
+      exit(1);
+    }
+    for(j = 0; j < NBLOCK; j++){
+      if(read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[0] != name[1]){
+        fprintf(2, "bcachetest: bad read of %s\n", name);
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+  exit(0);
+}
+
+// the next whitespace-separated field of s, which is advanced.
+char*
+field(char **s)
+{
+  char *f;
+
+  while(**s == ' ')
+    (*s)++;
+  f = *s;
+  while(**s && **s != ' ' && **s != '\n')
+    (*s)++;
+  if(**s == ' ')
+    *(*s)++ = 0;
+  return f;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int np = 4, i, fd, n, xstatus, acq = 0, cont = 0;
+  char name[3], *s, *f, *line, *next;
+
+  if(argc > 1)
+    np = atoi(argv[1]);
+  if(np < 1 || np > MAXP){
+    fprintf(2, "usage: bcachetest [nprocs]\n");
+    exit(1);
+  }
+
+  name[0] = 'f';
+  name[2] = 0;
+  for(i = 0; i < np; i++){
+    name[1] = '0' + i;
+    mkfile(name);
+  }
+
+  if((fd = open("statistics", O_WRONLY)) < 0 || write(fd, "0", 1) != 1){
+    fprintf(2, "bcachetest: can't reset statistics\n");
+    exit(1);
+  }
+  close(fd);
+
+  for(i = 0; i < np; i++){
+    name[1] = '0' + i;
+    if((n = fork()) < 0){
+      fprintf(2, "bcachetest: fork failed\n");
+      exit(1);
+    }
+    if(n == 0)
+      reader(name);
+  }
+  for(i = 0; i < np; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+
+  // sum acquires and contended acquires over the bcache locks.
+  n = statistics(stats, sizeof(stats) - 1);
+  stats[n] = 0;
+  for(line = stats; *line; line = next){
+    if((next = strchr(line, '\n')) == 0)
+      break;
+    *next++ = 0;
+    s = line;
+    f = field(&s);
+    if(strcmp(f, "bcache") != 0 && memcmp(f, "bcache.", 7) != 0)
+      continue;
+    field(&s);  // kind
+    field(&s);  // locks
+    acq += atoi(field(&s));
+    cont += atoi(field(&s));
+  }
+
+  for(i = 0; i < np; i++){
+    name[1] = '0' + i;
+    unlink(name);
+  }
+
+  printf("bcachetest: %d readers: bcache locks acquired %d times, %d contended\n",
+         np, acq, cont);
+  if(acq == 0 || cont * 100 >= acq){
+    printf("bcachetest: FAILED\n");
+    exit(1);
+  }
+  printf("bcachetest: OK\n");
+  exit(0);
+}
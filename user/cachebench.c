@@ -0,0 +1,109 @@
+// Re-read a set of files a few megabytes in all, more than the
+// NBUF buffers the cache always has, and report the time each pass
+// takes, the cache's hit rate over the passes, and how many
+// buffers it grew to.
+//
+//   cachebench [passes]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define NFILE 12
+#define FSZ   (200*1024)
+
+char buf[1024];
+
+void
+mkfile(char *name)
+{
+  int fd, i;
+
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "cachebench: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, name[1], sizeof(buf));
+  for(i = 0; i < FSZ; i += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "cachebench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+void
+readfile(char *name)
+{
+  int fd, n, tot = 0;
+
+  if((fd = open(name, O_RDONLY)) < 0){
+    fprintf(2, "cachebench: open %s failed\n", name);
+    exit(1);
+  }
+  while((n = read(fd, buf, sizeof(buf))) > 0){
+    if(buf[0] != name[1] || buf[n-1] != name[1]){
+      fprintf(2, "cachebench: bad data in %s\n", name);
+      exit(1);
+    }
+    tot += n;
+  }
+  close(fd);
+  if(tot != FSZ){
+    fprintf(2, "cachebench: read %d bytes of %s, not %d\n", tot, name, FSZ);
+    exit(1);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int passes = 3, i, j, t0;
+  char name[3];
+  struct sysinfo before, after;
+  uint64 hit, miss;
+
+  if(argc > 1)
+    passes = atoi(argv[1]);
+  if(passes < 1){
+    fprintf(2, "usage: cachebench [passes]\n");
+    exit(1);
+  }
+
+  name[0] = 'c';
+  name[2] = 0;
+  for(i = 0; i < NFILE; i++){
+    name[1] = 'a' + i;
+    mkfile(name);
+  }
+
+  if(sysinfo(&before) < 0){
+    fprintf(2, "cachebench: sysinfo failed\n");
+    exit(1);
+  }
+  for(j = 0; j < passes; j++){
+    t0 = uptime();
+    for(i = 0; i < NFILE; i++){
+      name[1] = 'a' + i;
+      readfile(name);
+    }
+    printf("cachebench: pass %d: %d KB in %d ticks\n", j, NFILE*FSZ/1024,
+           uptime() - t0);
+  }
+  sysinfo(&after);
+
+  for(i = 0; i < NFILE; i++){
+    name[1] = 'a' + i;
+    unlink(name);
+  }
+
+  hit = after.bhit - before.bhit;
+  miss = after.bmiss - before.bmiss;
+  printf("cachebench: %d block reads, %d hits (%d%%), cache of %d buffers\n",
+         (int)(hit + miss), (int)hit,
+         hit + miss ? (int)(hit * 100 / (hit + miss)) : 0, (int)after.nbuf);
+  exit(0);
+}
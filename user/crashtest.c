@@ -0,0 +1,129 @@
+// Crash recovery of the log. Writes a file, then overwrites it
+// in one transaction whose commit powers off the machine at the
+// given point:
+//
+//   1  log written, header not: recovery keeps the old data
+//   2  header written, nothing installed: recovery installs it
+//   3  half the blocks installed: recovery installs the rest
+//
+// Then boot again and check that the file is all old or all new
+// data, as the point says, never a mix:
+//
+//   make CRASHTEST=1 qemu
+//   crashtest 1|2|3
+//   (qemu stops; make CRASHTEST=1 qemu)
+//   crashtest check
+//
+// This checks the log protocol at each point, not the flushes
+// that order its writes: the power-off is an orderly exit of
+// qemu, which writes out its cache, so no unflushed write is
+// lost and the test passes even with every bflush() removed.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FILE   "crashtest.f"
+#define POINT  "crashtest.p"
+#define NBLOCK 3  // small enough for one transaction
+#define WAIT   100  // ticks to wait for the flusher to crash
+
+char buf[NBLOCK*1024];
+
+void
+fill(char *name, int c, int n)
+{
+  int fd;
+
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "crashtest: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, c, n);
+  if(write(fd, buf, n) != n){
+    fprintf(2, "crashtest: write %s failed\n", name);
+    exit(1);
+  }
+  close(fd);
+}
+
+void
+check(void)
+{
+  int fd, i, n, point;
+  char c, want;
+
+  if((fd = open(POINT, O_RDONLY)) < 0 || read(fd, &c, 1) != 1){
+    fprintf(2, "crashtest: no %s; run crashtest 1|2|3 first\n", POINT);
+    exit(1);
+  }
+  close(fd);
+  point = c - '0';
+  want = point == 1 ? 'a' : 'b';
+
+  if((fd = open(FILE, O_RDONLY)) < 0){
+    fprintf(2, "crashtest: can't open %s\n", FILE);
+    exit(1);
+  }
+  n = read(fd, buf, sizeof(buf));
+  close(fd);
+  unlink(FILE);
+  unlink(POINT);
+
+  if(n != sizeof(buf)){
+    printf("crashtest: point %d: read %d bytes, not %d\n", point, n, sizeof(buf));
+    printf("crashtest: FAILED\n");
+    exit(1);
+  }
+  for(i = 0; i < n; i++){
+    if(buf[i] != want){
+      printf("crashtest: point %d: byte %d is '%c', not '%c'\n",
+             point, i, buf[i], want);
+      printf("crashtest: FAILED\n");
+      exit(1);
+    }
+  }
+  printf("crashtest: point %d: file holds the %s data\n",
+         point, want == 'a' ? "old" : "new");
+  printf("crashtest: OK\n");
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int point, fd;
+
+  if(argc == 2 && strcmp(argv[1], "check") == 0)
+    check();
+  if(argc != 2 || (point = atoi(argv[1])) < 1 || point > 3){
+    fprintf(2, "usage: crashtest 1|2|3 | crashtest check\n");
+    exit(1);
+  }
+
+  fill(FILE, 'a', sizeof(buf));
+  fill(POINT, argv[1][0], 1);
+
+  if(crash(point) < 0){
+    fprintf(2, "crashtest: crash failed\n");
+    exit(1);
+  }
+  if((fd = open(FILE, O_WRONLY)) < 0){
+    fprintf(2, "crashtest: can't open %s\n", FILE);
+    exit(1);
+  }
+  memset(buf, 'b', sizeof(buf));
+  write(fd, buf, sizeof(buf));  // its commit stops the machine
+
+  // points 2 and 3 are in the flusher, which installs the
+  // transaction after write() has returned.
+  if(point > 1)
+    sleep(WAIT);
+
+  crash(0);
+  close(fd);
+  printf("crashtest: still running after the crash point\n");
+  printf("crashtest: FAILED\n");
+  exit(1);
+}
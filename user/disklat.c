@@ -0,0 +1,159 @@
+// Latency of single-block reads that go to the disk, with the
+// disk driver sleeping until the completion interrupt and with it
+// polling the used ring first (diskpoll()). Keeps the buffer cache
+// small as iops does, reads many one-block files round and round,
+// and prints a histogram of read() times for each mode.
+//
+//   disklat [poll-cycles]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NFILE  200
+#define PASSES 3
+#define SPARE  512  // pages the hog leaves free
+#define NHIST  16   // power-of-two microsecond buckets
+#define TIMEBASE 10 // time CSR ticks per microsecond in qemu
+
+char buf[1024];
+int hist[NHIST];
+
+void
+mkname(char *s, int i)
+{
+  s[0] = 'l';
+  s[1] = '0' + i / 100;
+  s[2] = '0' + i / 10 % 10;
+  s[3] = '0' + i % 10;
+  s[4] = 0;
+}
+
+void
+mkfiles(void)
+{
+  char name[5];
+  int fd, i;
+
+  for(i = 0; i < NFILE; i++){
+    mkname(name, i);
+    if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+      fprintf(2, "disklat: can't create %s\n", name);
+      exit(1);
+    }
+    memset(buf, name[3], sizeof(buf));
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "disklat: write failed\n");
+      exit(1);
+    }
+    close(fd);
+  }
+}
+
+// a child that takes all but SPARE pages of free memory, which
+// makes the kernel give back the cache's pages, and keeps them
+// until the returned descriptor is closed.
+int
+hog(void)
+{
+  int ready[2], hold[2], pid;
+  char c;
+
+  if(pipe(ready) < 0 || pipe(hold) < 0 || (pid = fork()) < 0){
+    fprintf(2, "disklat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(hold[1]);
+    while((uint64)sbrk(PGSIZE) != 0xffffffffffffffff)
+      ;
+    sbrk(-SPARE*PGSIZE);
+    write(ready[1], "x", 1);
+    read(hold[0], &c, 1);
+    exit(0);
+  }
+  close(hold[0]);
+  close(ready[1]);
+  read(ready[0], &c, 1);
+  close(ready[0]);
+  return hold[1];
+}
+
+// read every file PASSES times with the driver polling for up to
+// cycles, and print the histogram of read() latencies.
+void
+run(int cycles)
+{
+  char name[5];
+  int fd, i, j, b, n;
+  uint64 t0, t, tot;
+
+  if(diskpoll(cycles) < 0){
+    fprintf(2, "disklat: diskpoll failed\n");
+    exit(1);
+  }
+  memset(hist, 0, sizeof(hist));
+  tot = 0;
+  n = 0;
+  for(j = 0; j < PASSES; j++){
+    for(i = 0; i < NFILE; i++){
+      mkname(name, i);
+      if((fd = open(name, O_RDONLY)) < 0){
+        fprintf(2, "disklat: open %s failed\n", name);
+        exit(1);
+      }
+      t0 = r_time();
+      if(read(fd, buf, sizeof(buf)) != sizeof(buf) || buf[0] != name[3]){
+        fprintf(2, "disklat: bad read of %s\n", name);
+        exit(1);
+      }
+      t = (r_time() - t0) / TIMEBASE;
+      close(fd);
+      for(b = 0; b < NHIST - 1 && (1UL << (b + 1)) <= t; b++)
+        ;
+      hist[b]++;
+      tot += t;
+      n++;
+    }
+  }
+
+  if(cycles)
+    printf("disklat: polling up to %d cycles: %d reads, mean %d us\n",
+           cycles, n, (int)(tot / n));
+  else
+    printf("disklat: interrupts: %d reads, mean %d us\n", n, (int)(tot / n));
+  for(b = 0; b < NHIST; b++)
+    if(hist[b])
+      printf("  %d-%d us\t%d\n", b ? 1 << b : 0, (1 << (b + 1)) - 1, hist[b]);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int cycles = 50000, old, i, fd;
+  char name[5];
+
+  if(argc > 1)
+    cycles = atoi(argv[1]);
+  if(cycles <= 0){
+    fprintf(2, "usage: disklat [poll-cycles]\n");
+    exit(1);
+  }
+
+  mkfiles();
+  fd = hog();
+  old = diskpoll(-1);
+  run(0);
+  run(cycles);
+  diskpoll(old);
+  close(fd);
+  wait(0);
+
+  for(i = 0; i < NFILE; i++){
+    mkname(name, i);
+    unlink(name);
+  }
+  exit(0);
+}
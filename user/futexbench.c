@@ -0,0 +1,116 @@
+// Contention benchmark for the futex-based mutex and condition
+// variable in ulib.c, against the spin lock.
+//
+//   futexbench [nthreads]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define ITERS   20000
+#define PINGS   2000
+#define MAXT    8
+
+struct lock spin;
+struct mutex mu;
+struct cond cv;
+volatile int counter;
+volatile int turn;
+
+void
+spinworker(void *arg)
+{
+  for(int i = 0; i < ITERS; i++){
+    lock_acquire(&spin);
+    counter++;
+    lock_release(&spin);
+  }
+}
+
+void
+mutexworker(void *arg)
+{
+  for(int i = 0; i < ITERS; i++){
+    mutex_lock(&mu);
+    counter++;
+    mutex_unlock(&mu);
+  }
+}
+
+// two threads take turns, handing over through the condvar.
+void
+pinger(void *arg)
+{
+  int me = (uint64)arg;
+
+  for(int i = 0; i < PINGS; i++){
+    mutex_lock(&mu);
+    while(turn != me)
+      cond_wait(&cv, &mu);
+    turn = !me;
+    cond_signal(&cv);
+    mutex_unlock(&mu);
+  }
+}
+
+// run fn in nt threads; return elapsed ticks.
+int
+run(void (*fn)(void*), int nt)
+{
+  int tid[MAXT], t0, i;
+
+  t0 = uptime();
+  for(i = 0; i < nt; i++){
+    if((tid[i] = thread_create(fn, (void*)(uint64)i)) < 0){
+      fprintf(2, "futexbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  for(i = 0; i < nt; i++){
+    if(thread_join(tid[i]) != tid[i]){
+      fprintf(2, "futexbench: thread_join failed\n");
+      exit(1);
+    }
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nt = 4, t;
+
+  if(argc > 1)
+    nt = atoi(argv[1]);
+  if(nt < 1 || nt > MAXT){
+    fprintf(2, "usage: futexbench [nthreads <= %d]\n", MAXT);
+    exit(1);
+  }
+
+  lock_init(&spin);
+  mutex_init(&mu);
+  cond_init(&cv);
+
+  counter = 0;
+  t = run(spinworker, nt);
+  if(counter != nt * ITERS){
+    fprintf(2, "futexbench: spin lock lost updates\n");
+    exit(1);
+  }
+  printf("futexbench: %d threads x %d spin lock acquires: %d ticks\n", nt, ITERS, t);
+
+  counter = 0;
+  t = run(mutexworker, nt);
+  if(counter != nt * ITERS){
+    fprintf(2, "futexbench: mutex lost updates\n");
+    exit(1);
+  }
+  printf("futexbench: %d threads x %d mutex acquires: %d ticks\n", nt, ITERS, t);
+
+  turn = 0;
+  t = run(pinger, 2);
+  printf("futexbench: %d condvar round trips: %d ticks\n", PINGS, t);
+
+  printf("futexbench: OK\n");
+  exit(0);
+}
@@ -0,0 +1,162 @@
+// Disk reads per second: hold on to most of free memory so that
+// the buffer cache stays small, then have 1 and then n processes
+// each read its own file through, over and over, so that nearly
+// every block read goes to the disk. With several requests in the
+// virtio queue at once, n readers should get more done than one.
+//
+//   iops [nprocs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define FSZ    (256*1024)
+#define PASSES 4
+#define MAXP   8
+#define SPARE  512         // pages the hog leaves free
+#define TIMEBASE 10000000  // time CSR ticks per second in qemu
+
+char buf[1024];
+
+void
+mkname(char *s, int i)
+{
+  s[0] = 'i';
+  s[1] = '0' + i;
+  s[2] = 0;
+}
+
+void
+mkfile(int i)
+{
+  char name[3];
+  int fd, j;
+
+  mkname(name, i);
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "iops: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, name[1], sizeof(buf));
+  for(j = 0; j < FSZ; j += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "iops: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+void
+reader(int i)
+{
+  char name[3];
+  int fd, j, n, tot;
+
+  mkname(name, i);
+  for(j = 0; j < PASSES; j++){
+    if((fd = open(name, O_RDONLY)) < 0){
+      fprintf(2, "iops: open %s failed\n", name);
+      exit(1);
+    }
+    tot = 0;
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      tot += n;
+    close(fd);
+    if(tot != FSZ){
+      fprintf(2, "iops: read %d bytes of %s, not %d\n", tot, name, FSZ);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// a child that takes all but SPARE pages of free memory, which
+// makes the kernel give back the cache's pages, and keeps them
+// until the returned descriptor is closed.
+int
+hog(void)
+{
+  int ready[2], hold[2], pid;
+  char c;
+
+  if(pipe(ready) < 0 || pipe(hold) < 0 || (pid = fork()) < 0){
+    fprintf(2, "iops: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(hold[1]);
+    while((uint64)sbrk(PGSIZE) != 0xffffffffffffffff)
+      ;
+    sbrk(-SPARE*PGSIZE);
+    write(ready[1], "x", 1);
+    read(hold[0], &c, 1);
+    exit(0);
+  }
+  close(hold[0]);
+  close(ready[1]);
+  read(ready[0], &c, 1);
+  close(ready[0]);
+  return hold[1];
+}
+
+// run np readers at once and print the disk reads per second.
+void
+run(int np)
+{
+  int i, pid, xstatus;
+  uint64 t0, t;
+  struct sysinfo before, after;
+
+  sysinfo(&before);
+  t0 = r_time();
+  for(i = 0; i < np; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "iops: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      reader(i);
+  }
+  for(i = 0; i < np; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  t = r_time() - t0;
+  sysinfo(&after);
+  printf("iops: %d readers: %d disk reads in %d ms, %d per second\n", np,
+         (int)(after.bmiss - before.bmiss), (int)(t / (TIMEBASE / 1000)),
+         t ? (int)((after.bmiss - before.bmiss) * TIMEBASE / t) : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int np = 4, i, fd;
+  char name[3];
+
+  if(argc > 1)
+    np = atoi(argv[1]);
+  if(np < 1 || np > MAXP){
+    fprintf(2, "usage: iops [nprocs]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < np; i++)
+    mkfile(i);
+  fd = hog();
+  run(1);
+  run(np);
+  close(fd);
+  wait(0);
+
+  for(i = 0; i < np; i++){
+    mkname(name, i);
+    unlink(name);
+  }
+  exit(0);
+}
@@ -0,0 +1,85 @@
+// Stress one hot kernel spinlock from threads pinned to different
+// harts, and report throughput and how evenly the lock was shared.
+// futex_wake() on a word nobody waits on does little more than take
+// and drop the lock of that word's futex hash bucket.
+//
+// Build the kernel with TICKETLOCK set to 1 and to 0 in
+// kernel/param.h to compare the ticket lock with test-and-set.
+//
+//   lockbench [nthreads] [ticks]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define MAXT 8
+
+int word;
+volatile int go, stop;
+int count[MAXT];
+
+void
+worker(void *arg)
+{
+  int me = (uint64)arg, n = 0;
+
+  if(sched_setaffinity(0, 1UL << me) < 0){
+    fprintf(2, "lockbench: sched_setaffinity failed\n");
+    exit(1);
+  }
+  while(!go)
+    ;
+  while(!stop){
+    futex_wake(&word, 1);
+    n++;
+  }
+  count[me] = n;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nt = 3, nticks = 20, tid[MAXT], i, total, min, max;
+
+  if(argc > 1)
+    nt = atoi(argv[1]);
+  if(argc > 2)
+    nticks = atoi(argv[2]);
+  if(nt < 1 || nt > MAXT || nticks < 1){
+    fprintf(2, "usage: lockbench [nthreads] [ticks]\n");
+    exit(1);
+  }
+
+  for(i = 0; i < nt; i++){
+    if((tid[i] = thread_create(worker, (void*)(uint64)i)) < 0){
+      fprintf(2, "lockbench: thread_create failed\n");
+      exit(1);
+    }
+  }
+  sleep(1);  // let every thread reach its hart
+  go = 1;
+  sleep(nticks);
+  stop = 1;
+  for(i = 0; i < nt; i++){
+    if(thread_join(tid[i]) != tid[i]){
+      fprintf(2, "lockbench: thread_join failed\n");
+      exit(1);
+    }
+  }
+
+  total = 0;
+  min = max = count[0];
+  for(i = 0; i < nt; i++){
+    printf("lockbench: hart %d: %d acquires\n", i, count[i]);
+    total += count[i];
+    if(count[i] < min)
+      min = count[i];
+    if(count[i] > max)
+      max = count[i];
+  }
+  printf("lockbench: %d threads, %d acquires in %d ticks, %d per tick\n",
+         nt, total, nticks, total / nticks);
+  printf("lockbench: fairness (fewest/most) %d%%\n",
+         max ? min * 100 / max : 100);
+  exit(0);
+}
@@ -0,0 +1,121 @@
+// How well the I/O scheduler merges: large sequential file writes,
+// then many small log commits (creating, writing and removing
+// small files), each by n processes at once. For each, reports
+// the time taken, the disk requests, and the blocks per request.
+//
+//   mergebench [nprocs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define FSZ    (200*1024)
+#define WSZ    (8*1024)    // bytes per write()
+#define NSMALL 40          // small files per process
+#define MAXP   8
+
+char buf[WSZ];
+
+void
+bigwriter(int i)
+{
+  char name[3];
+  int fd, j;
+
+  name[0] = 'm';
+  name[1] = '0' + i;
+  name[2] = 0;
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "mergebench: can't create %s\n", name);
+    exit(1);
+  }
+  for(j = 0; j < FSZ; j += WSZ){
+    if(write(fd, buf, WSZ) != WSZ){
+      fprintf(2, "mergebench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+  unlink(name);
+  exit(0);
+}
+
+void
+smallwriter(int i)
+{
+  char name[4];
+  int fd, j;
+
+  name[0] = 's';
+  name[1] = '0' + i;
+  name[3] = 0;
+  for(j = 0; j < NSMALL; j++){
+    name[2] = 'a' + j % 26;
+    if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+      fprintf(2, "mergebench: can't create %s\n", name);
+      exit(1);
+    }
+    if(write(fd, buf, 1024) != 1024){
+      fprintf(2, "mergebench: write failed\n");
+      exit(1);
+    }
+    close(fd);
+    unlink(name);
+  }
+  exit(0);
+}
+
+// run np copies of f at once and print what the disk saw.
+void
+run(char *what, int np, void (*f)(int))
+{
+  int i, pid, xstatus, t0, t, req;
+  struct sysinfo before, after;
+
+  sysinfo(&before);
+  t0 = uptime();
+  for(i = 0; i < np; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "mergebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      f(i);
+  }
+  for(i = 0; i < np; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  t = uptime() - t0;
+  sysinfo(&after);
+
+  req = after.ioreq - before.ioreq;
+  printf("mergebench: %s: %d ticks, %d disk requests, %d blocks merged",
+         what, t, req, (int)(after.iomerge - before.iomerge));
+  if(req > 0){
+    i = (req + after.iomerge - before.iomerge) * 100 / req;
+    printf(", %d.%d%d blocks per request", i / 100, i / 10 % 10, i % 10);
+  }
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int np = 4;
+
+  if(argc > 1)
+    np = atoi(argv[1]);
+  if(np < 1 || np > MAXP){
+    fprintf(2, "usage: mergebench [nprocs]\n");
+    exit(1);
+  }
+
+  memset(buf, 'm', sizeof(buf));
+  run("large writes", np, bigwriter);
+  run("small commits", np, smallwriter);
+  exit(0);
+}
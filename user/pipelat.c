@@ -0,0 +1,73 @@
+// Round-trip latency over a pair of pipes: the parent writes a
+// byte, the child echoes it back. Runs once with both processes
+// pinned to hart 0, where each round trip is two handoffs, and
+// once unpinned.
+//
+//   pipelat [roundtrips]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+int
+pingpong(int n, uint64 mask)
+{
+  int ping[2], pong[2], pid, i, t0, t1;
+  char c = 'x';
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    fprintf(2, "pipelat: pipe failed\n");
+    exit(1);
+  }
+  if(sched_setaffinity(0, mask) < 0){
+    fprintf(2, "pipelat: sched_setaffinity failed\n");
+    exit(1);
+  }
+
+  if((pid = fork()) < 0){
+    fprintf(2, "pipelat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(ping[1]);
+    close(pong[0]);
+    while(read(ping[0], &c, 1) == 1)
+      write(pong[1], &c, 1);
+    exit(0);
+  }
+  close(ping[0]);
+  close(pong[1]);
+
+  t0 = uptime();
+  for(i = 0; i < n; i++){
+    if(write(ping[1], &c, 1) != 1 || read(pong[0], &c, 1) != 1){
+      fprintf(2, "pipelat: round trip %d failed\n", i);
+      exit(1);
+    }
+  }
+  t1 = uptime();
+
+  close(ping[1]);
+  close(pong[0]);
+  wait(0);
+  return t1 - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 10000, t;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: pipelat [roundtrips]\n");
+    exit(1);
+  }
+
+  t = pingpong(n, 1);
+  printf("pipelat: %d round trips on one hart: %d ticks\n", n, t);
+  t = pingpong(n, -1);
+  printf("pipelat: %d round trips on any hart: %d ticks\n", n, t);
+  exit(0);
+}
@@ -0,0 +1,31 @@
+// List processes with their resource usage.
+
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+struct procstat ps[NPROC];
+
+int
+main(int argc, char *argv[])
+{
+  int i, n;
+  struct rusage *ru;
+
+  if((n = pstat(ps, NPROC)) < 0){
+    fprintf(2, "ps: pstat failed\n");
+    exit(1);
+  }
+  printf("PID\tPPID\tSTATE\tUTIME\tSTIME\tVCSW\tIVCSW\tFAULT\tSYSCALL\tINBLK\tOUTBLK\tNAME\n");
+  for(i = 0; i < n; i++){
+    ru = &ps[i].ru;
+    printf("%d\t%d\t%s\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%d\t%s\n",
+           ps[i].pid, ps[i].ppid, ps[i].state,
+           (int)ru->utime, (int)ru->stime, (int)ru->nvcsw, (int)ru->nivcsw,
+           (int)ru->nfault, (int)ru->nsyscall, (int)ru->inblock,
+           (int)ru->oublock, ps[i].name);
+  }
+  exit(0);
+}
@@ -0,0 +1,79 @@
+// Parallel sum: add up an array with 1, 2, ... threads and
+// report how long each takes, to see threads scale across harts.
+//
+//   psum [maxthreads]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define N       (64*1024)
+#define ROUNDS  200
+#define MAXT    8
+
+int a[N];
+
+struct part {
+  int lo, hi;
+  uint64 sum;
+  char pad[64];     // keep threads' results on separate cache lines
+} parts[MAXT];
+
+void
+sumpart(void *arg)
+{
+  struct part *pt = arg;
+  uint64 sum = 0;
+
+  for(int r = 0; r < ROUNDS; r++)
+    for(int i = pt->lo; i < pt->hi; i++)
+      sum += a[i];
+  pt->sum = sum;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int maxt = 4, nt, i, t0, t1, tid[MAXT];
+  uint64 want = 0, sum;
+
+  if(argc > 1)
+    maxt = atoi(argv[1]);
+  if(maxt < 1 || maxt > MAXT){
+    fprintf(2, "usage: psum [maxthreads <= %d]\n", MAXT);
+    exit(1);
+  }
+
+  for(i = 0; i < N; i++){
+    a[i] = i;
+    want += i;
+  }
+  want *= ROUNDS;
+
+  for(nt = 1; nt <= maxt; nt++){
+    t0 = uptime();
+    for(i = 0; i < nt; i++){
+      parts[i].lo = N / nt * i;
+      parts[i].hi = i == nt-1 ? N : N / nt * (i+1);
+      if((tid[i] = thread_create(sumpart, &parts[i])) < 0){
+        fprintf(2, "psum: thread_create failed\n");
+        exit(1);
+      }
+    }
+    sum = 0;
+    for(i = 0; i < nt; i++){
+      if(thread_join(tid[i]) != tid[i]){
+        fprintf(2, "psum: thread_join failed\n");
+        exit(1);
+      }
+      sum += parts[i].sum;
+    }
+    t1 = uptime();
+    if(sum != want){
+      fprintf(2, "psum: %d threads got the wrong sum\n", nt);
+      exit(1);
+    }
+    printf("psum: %d threads: %d ticks\n", nt, t1 - t0);
+  }
+  exit(0);
+}
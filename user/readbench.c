@@ -0,0 +1,105 @@
+// Parallel reads of one file: each of n processes opens the same
+// file and reads it through again and again, so they all lock the
+// same inode. Reports throughput with one reader and with n.
+//
+//   readbench [nprocs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FILE   "readbench.tmp"
+#define FSZ    (32*1024)
+#define PASSES 40
+#define MAXP   8
+
+char buf[512];
+
+void
+mkfile(void)
+{
+  int fd, i;
+
+  if((fd = open(FILE, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "readbench: can't create %s\n", FILE);
+    exit(1);
+  }
+  memset(buf, 'r', sizeof(buf));
+  for(i = 0; i < FSZ; i += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "readbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+void
+reader(void)
+{
+  int fd, i, n, tot;
+
+  for(i = 0; i < PASSES; i++){
+    if((fd = open(FILE, O_RDONLY)) < 0){
+      fprintf(2, "readbench: open failed\n");
+      exit(1);
+    }
+    tot = 0;
+    while((n = read(fd, buf, sizeof(buf))) > 0)
+      tot += n;
+    close(fd);
+    if(tot != FSZ){
+      fprintf(2, "readbench: read %d bytes, not %d\n", tot, FSZ);
+      exit(1);
+    }
+  }
+  exit(0);
+}
+
+// run np readers at once; returns elapsed ticks.
+int
+run(int np)
+{
+  int i, t0, xstatus, pid;
+
+  t0 = uptime();
+  for(i = 0; i < np; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "readbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0)
+      reader();
+  }
+  for(i = 0; i < np; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int np = 3, t1, tn;
+
+  if(argc > 1)
+    np = atoi(argv[1]);
+  if(np < 1 || np > MAXP){
+    fprintf(2, "usage: readbench [nprocs]\n");
+    exit(1);
+  }
+
+  mkfile();
+  t1 = run(1);
+  tn = run(np);
+  unlink(FILE);
+
+  printf("readbench: 1 reader: %d KB in %d ticks\n", PASSES*FSZ/1024, t1);
+  printf("readbench: %d readers: %d KB in %d ticks\n", np, np*PASSES*FSZ/1024, tn);
+  if(tn > 0 && t1 > 0)
+    printf("readbench: speedup %d%%\n", np * t1 * 100 / tn);
+  exit(0);
+}
@@ -0,0 +1,135 @@
+// Deadline misses of a periodic task while CPU-bound processes
+// keep every hart busy: once as an ordinary process that sleeps
+// until each next period, and once as a real-time task under
+// rtsched(). The real-time run should miss nothing.
+//
+//   rttest [jobs]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NLOAD  8     // CPU-bound background processes
+#define PERIOD 3     // ticks
+#define BUDGET 1     // ticks
+#define WORK   100000
+
+volatile int sink;
+
+void
+work(void)
+{
+  int i;
+
+  for(i = 0; i < WORK; i++)
+    sink += i;
+}
+
+// run n jobs as an ordinary process; returns the misses.
+int
+ordinary(int n)
+{
+  int j, misses = 0, now;
+  int deadline = uptime() + PERIOD;
+
+  for(j = 0; j < n; j++){
+    work();
+    now = uptime();
+    if(now >= deadline){
+      misses++;
+      deadline = now;
+    }
+    sleep(deadline - now);
+    deadline += PERIOD;
+  }
+  return misses;
+}
+
+// run n jobs as a real-time task; returns the misses.
+int
+realtime(int n)
+{
+  int j, misses = 0;
+
+  if(rtsched(PERIOD, BUDGET) < 0){
+    fprintf(2, "rttest: rtsched failed\n");
+    exit(-1);
+  }
+  for(j = 0; j < n; j++){
+    work();
+    if((misses = rtwait()) < 0){
+      fprintf(2, "rttest: rtwait failed\n");
+      exit(-1);
+    }
+  }
+  return misses;
+}
+
+// run the periodic task in a child; returns its misses.
+int
+run(int n, int rt)
+{
+  int pid, xstatus;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "rttest: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0)
+    exit(rt ? realtime(n) : ordinary(n));
+  wait(&xstatus);
+  if(xstatus < 0)
+    exit(1);
+  return xstatus;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int n = 50, i, pids[NLOAD], ord, rt;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n <= 0){
+    fprintf(2, "usage: rttest [jobs]\n");
+    exit(1);
+  }
+
+  // admission control: a whole hart is more than may be reserved.
+  if(rtsched(1, 1) == 0){
+    fprintf(2, "rttest: rtsched(1, 1) was admitted\n");
+    exit(1);
+  }
+  if(rtsched(PERIOD, PERIOD + 1) == 0){
+    fprintf(2, "rttest: budget above period was admitted\n");
+    exit(1);
+  }
+
+  for(i = 0; i < NLOAD; i++){
+    if((pids[i] = fork()) < 0){
+      fprintf(2, "rttest: fork failed\n");
+      exit(1);
+    }
+    if(pids[i] == 0)
+      for(;;)
+        sink++;
+  }
+
+  ord = run(n, 0);
+  rt = run(n, 1);
+
+  for(i = 0; i < NLOAD; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+
+  printf("rttest: %d jobs, period %d, %d busy processes\n", n, PERIOD, NLOAD);
+  printf("rttest: ordinary: %d deadline misses\n", ord);
+  printf("rttest: real-time: %d deadline misses\n", rt);
+  if(rt != 0){
+    printf("rttest: FAILED\n");
+    exit(1);
+  }
+  printf("rttest: OK\n");
+  exit(0);
+}
@@ -0,0 +1,203 @@
+// Metadata hit rate during a scan: hold on to most of free memory
+// so that the buffer cache can't grow, then look up and stat a
+// directory of small files over and over, once alone and once
+// while another process reads big files through again and again.
+// A scan-resistant cache keeps the lookups' inode and directory
+// blocks through the scan.
+//
+//   scanbench [rounds]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/rusage.h"
+#include "user/user.h"
+
+#define NMETA  64          // small files
+#define NBIG   8           // big files
+#define BIGSZ  (256*1024)
+#define SPARE  512         // pages the hog leaves free
+
+char buf[1024];
+
+void
+name(char *s, char kind, int i)
+{
+  s[0] = 's';
+  s[1] = 'b';
+  s[2] = '/';
+  s[3] = kind;
+  s[4] = '0' + i / 10;
+  s[5] = '0' + i % 10;
+  s[6] = 0;
+}
+
+void
+mkfiles(void)
+{
+  char path[8];
+  int i, j, fd;
+
+  if(mkdir("sb") < 0){
+    fprintf(2, "scanbench: mkdir sb failed\n");
+    exit(1);
+  }
+  memset(buf, 'b', sizeof(buf));
+  for(i = 0; i < NMETA + NBIG; i++){
+    if(i < NMETA)
+      name(path, 'm', i);
+    else
+      name(path, 'b', i - NMETA);
+    if((fd = open(path, O_CREATE|O_WRONLY)) < 0){
+      fprintf(2, "scanbench: can't create %s\n", path);
+      exit(1);
+    }
+    for(j = 0; i >= NMETA && j < BIGSZ; j += sizeof(buf)){
+      if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+        fprintf(2, "scanbench: write failed\n");
+        exit(1);
+      }
+    }
+    close(fd);
+  }
+}
+
+void
+rmfiles(void)
+{
+  char path[8];
+  int i;
+
+  for(i = 0; i < NMETA; i++){
+    name(path, 'm', i);
+    unlink(path);
+  }
+  for(i = 0; i < NBIG; i++){
+    name(path, 'b', i);
+    unlink(path);
+  }
+  unlink("sb");
+}
+
+// a child that takes all but SPARE pages of free memory, which
+// makes the kernel give back the cache's pages, and keeps them
+// until the returned descriptor is closed.
+int
+hog(void)
+{
+  int ready[2], hold[2], pid;
+  char c;
+
+  if(pipe(ready) < 0 || pipe(hold) < 0 || (pid = fork()) < 0){
+    fprintf(2, "scanbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    close(hold[1]);
+    while((uint64)sbrk(PGSIZE) != 0xffffffffffffffff)
+      ;
+    sbrk(-SPARE*PGSIZE);
+    write(ready[1], "x", 1);
+    read(hold[0], &c, 1);
+    exit(0);
+  }
+  close(hold[0]);
+  close(ready[1]);
+  read(ready[0], &c, 1);
+  close(ready[0]);
+  return hold[1];
+}
+
+// the metadata workload, in a child; returns its hit rate in
+// per mille of block reads.
+int
+meta(int rounds)
+{
+  int pid, r, i, fd, xstatus;
+  char path[8];
+  struct stat st;
+  struct rusage ru;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "scanbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    for(r = 0; r < rounds; r++){
+      for(i = 0; i < NMETA; i++){
+        name(path, 'm', i);
+        if((fd = open(path, O_RDONLY)) < 0 || fstat(fd, &st) < 0){
+          fprintf(2, "scanbench: can't stat %s\n", path);
+          exit(-1);
+        }
+        close(fd);
+      }
+    }
+    getrusage(0, &ru);
+    if(ru.hitblock + ru.inblock == 0)
+      exit(1000);
+    exit(ru.hitblock * 1000 / (ru.hitblock + ru.inblock));
+  }
+  wait(&xstatus);
+  if(xstatus < 0)
+    exit(1);
+  return xstatus;
+}
+
+// a child that reads the big files through until killed.
+int
+scanner(void)
+{
+  char path[8];
+  int pid, i, fd;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "scanbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    for(;;){
+      for(i = 0; i < NBIG; i++){
+        name(path, 'b', i);
+        if((fd = open(path, O_RDONLY)) < 0)
+          exit(1);
+        while(read(fd, buf, sizeof(buf)) > 0)
+          ;
+        close(fd);
+      }
+    }
+  }
+  return pid;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int rounds = 20, alone, scanning, pid, fd;
+
+  if(argc > 1)
+    rounds = atoi(argv[1]);
+  if(rounds < 1){
+    fprintf(2, "usage: scanbench [rounds]\n");
+    exit(1);
+  }
+
+  mkfiles();
+  fd = hog();
+
+  alone = meta(rounds);
+  pid = scanner();
+  scanning = meta(rounds);
+  kill(pid);
+  wait(0);
+
+  close(fd);
+  wait(0);
+  rmfiles();
+
+  printf("scanbench: metadata hit rate alone: %d.%d%%\n", alone / 10, alone % 10);
+  printf("scanbench: metadata hit rate during a scan: %d.%d%%\n",
+         scanning / 10, scanning % 10);
+  exit(0);
+}
@@ -0,0 +1,130 @@
+// Sequential read throughput: write a few large files, push their
+// blocks out of the buffer cache by using up free memory (which
+// makes the kernel reclaim the cache), then read them through from
+// cold and again from warm.
+//
+// Build the kernel with READAHEAD set to 0 in kernel/param.h to
+// compare with no read-ahead.
+//
+//   seqread [nfiles]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+#define FSZ   (256*1024)
+#define MAXF  8
+
+char buf[1024];
+
+void
+mkfile(char *name)
+{
+  int fd, i;
+
+  if((fd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "seqread: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, name[1], sizeof(buf));
+  for(i = 0; i < FSZ; i += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "seqread: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+}
+
+// allocate memory until there's none, in a child, so that the
+// kernel gives back the cache's pages.
+void
+dropcache(void)
+{
+  int pid;
+
+  if((pid = fork()) < 0){
+    fprintf(2, "seqread: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    while((uint64)sbrk(PGSIZE) != 0xffffffffffffffff)
+      ;
+    exit(0);
+  }
+  wait(0);
+}
+
+// read the files through; returns elapsed ticks.
+int
+readall(int nf)
+{
+  int i, fd, n, tot, t0;
+  char name[3];
+
+  t0 = uptime();
+  name[0] = 's';
+  name[2] = 0;
+  for(i = 0; i < nf; i++){
+    name[1] = 'a' + i;
+    if((fd = open(name, O_RDONLY)) < 0){
+      fprintf(2, "seqread: open %s failed\n", name);
+      exit(1);
+    }
+    tot = 0;
+    while((n = read(fd, buf, sizeof(buf))) > 0){
+      if(buf[0] != name[1]){
+        fprintf(2, "seqread: bad data in %s\n", name);
+        exit(1);
+      }
+      tot += n;
+    }
+    close(fd);
+    if(tot != FSZ){
+      fprintf(2, "seqread: read %d bytes of %s, not %d\n", tot, name, FSZ);
+      exit(1);
+    }
+  }
+  return uptime() - t0;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int nf = 4, i, cold, warm;
+  char name[3];
+  struct sysinfo before, after;
+
+  if(argc > 1)
+    nf = atoi(argv[1]);
+  if(nf < 1 || nf > MAXF){
+    fprintf(2, "usage: seqread [nfiles]\n");
+    exit(1);
+  }
+
+  name[0] = 's';
+  name[2] = 0;
+  for(i = 0; i < nf; i++){
+    name[1] = 'a' + i;
+    mkfile(name);
+  }
+
+  dropcache();
+  sysinfo(&before);
+  cold = readall(nf);
+  sysinfo(&after);
+  warm = readall(nf);
+
+  for(i = 0; i < nf; i++){
+    name[1] = 'a' + i;
+    unlink(name);
+  }
+
+  printf("seqread: cold: %d KB in %d ticks, %d blocks from disk\n",
+         nf*FSZ/1024, cold, (int)(after.bmiss - before.bmiss));
+  printf("seqread: warm: %d KB in %d ticks\n", nf*FSZ/1024, warm);
+  exit(0);
+}
@@ -0,0 +1,56 @@
+// Print lock statistics: for each lock name, how many locks,
+// acquires, contended acquires, spins, sleeps, cycles spent waiting,
+// and the longest hold, most contended first. Given a command, zero
+// the counters, run it, and print the top locks during its run.
+//
+//   stats [-n top] [command [args...]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define SZ 8192  // more than the kernel's snapshot, so a read hits its end
+
+char buf[SZ];
+
+int
+main(int argc, char *argv[])
+{
+  int i, n, fd, pid, top = -1, lines;
+
+  if(argc > 2 && strcmp(argv[1], "-n") == 0){
+    top = atoi(argv[2]);
+    argc -= 2;
+    argv += 2;
+  }
+
+  if(argc > 1){
+    if(top < 0)
+      top = 10;
+    if((fd = open("statistics", O_WRONLY)) < 0 || write(fd, "0", 1) != 1){
+      fprintf(2, "stats: can't reset statistics\n");
+      exit(1);
+    }
+    close(fd);
+    if((pid = fork()) < 0){
+      fprintf(2, "stats: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], argv + 1);
+      fprintf(2, "stats: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+
+  n = statistics(buf, SZ);
+  // the header line, then top lines.
+  lines = 0;
+  for(i = 0; i < n && (top < 0 || lines <= top); i++)
+    if(buf[i] == '\n')
+      lines++;
+  write(1, buf, i);
+  exit(0);
+}
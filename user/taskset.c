@@ -0,0 +1,75 @@
+#include "kernel/param.h"
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// taskset mask command [args...]
+//   run command on the harts whose bits are set in mask.
+// taskset -p pid [mask]
+//   show, or set, the hart mask of a running process.
+// masks are in hex, like 0x3 or 5.
+
+uint64
+parsemask(char *s)
+{
+  uint64 mask = 0;
+  int c;
+
+  if(s[0] == '0' && (s[1] == 'x' || s[1] == 'X'))
+    s += 2;
+  for(; (c = *s) != 0; s++){
+    if(c >= '0' && c <= '9')
+      c -= '0';
+    else if(c >= 'a' && c <= 'f')
+      c -= 'a' - 10;
+    else if(c >= 'A' && c <= 'F')
+      c -= 'A' - 10;
+    else
+      return 0;
+    mask = (mask << 4) | c;
+  }
+  return mask;
+}
+
+void
+usage(void)
+{
+  fprintf(2, "usage: taskset mask command [args...]\n");
+  fprintf(2, "       taskset -p pid [mask]\n");
+  exit(1);
+}
+
+int
+main(int argc, char *argv[])
+{
+  uint64 mask;
+  int pid;
+
+  if(argc >= 3 && strcmp(argv[1], "-p") == 0){
+    pid = atoi(argv[2]);
+    if(argc == 4){
+      if((mask = parsemask(argv[3])) == 0)
+        usage();
+      if(sched_setaffinity(pid, mask) < 0){
+        fprintf(2, "taskset: cannot set affinity of pid %d\n", pid);
+        exit(1);
+      }
+    }
+    if(sched_getaffinity(pid, &mask) < 0){
+      fprintf(2, "taskset: no process %d\n", pid);
+      exit(1);
+    }
+    printf("pid %d's affinity mask: %p\n", pid, mask);
+    exit(0);
+  }
+
+  if(argc < 3 || (mask = parsemask(argv[1])) == 0)
+    usage();
+  if(sched_setaffinity(0, mask) < 0){
+    fprintf(2, "taskset: no running hart in mask %s\n", argv[1]);
+    exit(1);
+  }
+  exec(argv[2], argv + 2);
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
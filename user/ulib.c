@@ -134,3 +134,148 @@ memcpy(void *dst, const void *src, uint n)
 {
   return memmove(dst, src, n);
 }
+
+// A spin lock for threads that share an address space.
+void
+lock_init(struct lock *lk)
+{
+  lk->locked = 0;
+}
+
+void
+lock_acquire(struct lock *lk)
+{
+  while(__sync_lock_test_and_set(&lk->locked, 1) != 0)
+    ;
+  __sync_synchronize();
+}
+
+void
+lock_release(struct lock *lk)
+{
+  __sync_synchronize();
+  __sync_lock_release(&lk->locked);
+}
+
+// A mutex that sleeps in the kernel, via futex_wait(),
+// only when it is contended.
+void
+mutex_init(struct mutex *m)
+{
+  m->state = 0;
+}
+
+void
+mutex_lock(struct mutex *m)
+{
+  int c;
+
+  if((c = __sync_val_compare_and_swap(&m->state, 0, 1)) == 0)
+    return;
+  // say that there are waiters, then sleep until the holder
+  // lets go; whoever gets it next must wake the others.
+  if(c != 2)
+    c = __sync_lock_test_and_set(&m->state, 2);
+  while(c != 0){
+    futex_wait((int*)&m->state, 2);
+    c = __sync_lock_test_and_set(&m->state, 2);
+  }
+}
+
+void
+mutex_unlock(struct mutex *m)
+{
+  if(__sync_fetch_and_sub(&m->state, 1) != 1){
+    m->state = 0;
+    futex_wake((int*)&m->state, 1);
+  }
+}
+
+// A condition variable: a waiter sleeps until seq moves on.
+void
+cond_init(struct cond *c)
+{
+  c->seq = 0;
+}
+
+void
+cond_wait(struct cond *c, struct mutex *m)
+{
+  int seq = c->seq;
+
+  mutex_unlock(m);
+  futex_wait((int*)&c->seq, seq);
+  mutex_lock(m);
+}
+
+void
+cond_signal(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake((int*)&c->seq, 1);
+}
+
+void
+cond_broadcast(struct cond *c)
+{
+  __sync_fetch_and_add(&c->seq, 1);
+  futex_wake((int*)&c->seq, 0x7fffffff);
+}
+
+// What a new thread should run; sits at the top of its stack.
+struct thread_start {
+  void (*fn)(void *);
+  void *arg;
+};
+
+// malloc() and free() are not thread-safe.
+static struct lock malloclock;
+
+static void
+thread_entry(void *a)
+{
+  struct thread_start *ts = a;
+
+  ts->fn(ts->arg);
+  exit(0);
+}
+
+// Start a thread running fn(arg) on a new THREAD_STACK-byte
+// stack. Returns its thread id, or -1.
+int
+thread_create(void (*fn)(void *), void *arg)
+{
+  char *stack;
+  struct thread_start *ts;
+  int tid;
+
+  lock_acquire(&malloclock);
+  stack = malloc(THREAD_STACK);
+  lock_release(&malloclock);
+  if(stack == 0)
+    return -1;
+  ts = (struct thread_start*)(stack + THREAD_STACK) - 1;
+  ts->fn = fn;
+  ts->arg = arg;
+  if((tid = clone(thread_entry, ts, ts)) < 0){
+    lock_acquire(&malloclock);
+    free(stack);
+    lock_release(&malloclock);
+  }
+  return tid;
+}
+
+// Wait for thread tid (any thread if 0) to finish, and free its
+// stack. Only the main thread may join. Returns the thread id, or -1.
+int
+thread_join(int tid)
+{
+  void *sp;
+
+  if((tid = join(tid, &sp)) < 0)
+    return -1;
+  lock_acquire(&malloclock);
+  free((char*)sp + sizeof(struct thread_start) - THREAD_STACK);
+  lock_release(&malloclock);
+  return tid;
+}
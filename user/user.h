@@ -27,6 +27,23 @@ int trace(int);
 
 struct sysinfo;
 int sysinfo(struct sysinfo *);
+int sched_setaffinity(int, uint64);
+int sched_getaffinity(int, uint64 *);
+int clone(void (*)(void *), void *, void *);
+int join(int, void **);
+int futex_wait(int *, int);
+int futex_wake(int *, int);
+struct sigframe;
+int sigalarm(int, void (*)(struct sigframe *));
+int sigreturn(void);
+struct rusage;
+struct procstat;
+int getrusage(int, struct rusage *);
+int pstat(struct procstat *, int);
+int rtsched(int, int);
+int rtwait(void);
+int diskpoll(int);
+int crash(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -44,3 +61,30 @@ void free(void*);
 int atoi(const char*);
 int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
+
+// ulib.c: threads
+#define THREAD_STACK 4096
+struct lock {
+  volatile uint locked;
+};
+int thread_create(void (*)(void *), void *);
+int thread_join(int);
+void lock_init(struct lock *);
+void lock_acquire(struct lock *);
+void lock_release(struct lock *);
+struct mutex {
+  volatile int state;   // 0 unlocked, 1 locked, 2 locked with waiters
+};
+struct cond {
+  volatile int seq;
+};
+void mutex_init(struct mutex *);
+void mutex_lock(struct mutex *);
+void mutex_unlock(struct mutex *);
+void cond_init(struct cond *);
+void cond_wait(struct cond *, struct mutex *);
+void cond_signal(struct cond *);
+void cond_broadcast(struct cond *);
+
+// statistics.c
+int statistics(void*, int);
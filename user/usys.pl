@@ -37,4 +37,18 @@ entry("sbrk");
 entry("sleep");
 entry("uptime");
 entry("trace");
-entry("sysinfo");
\ No newline at end of file
+entry("sysinfo");
+entry("sched_setaffinity");
+entry("sched_getaffinity");
+entry("clone");
+entry("join");
+entry("futex_wait");
+entry("futex_wake");
+entry("sigalarm");
+entry("sigreturn");
+entry("getrusage");
+entry("pstat");
+entry("rtsched");
+entry("rtwait");
+entry("diskpoll");
+entry("crash");
\ No newline at end of file
@@ -0,0 +1,109 @@
+// write() latency under concurrent writers: each of n processes
+// appends 1 KB at a time to its own file, timing every write()
+// with the time CSR, and the average and the worst are reported.
+// Each write() is a whole log transaction, so its latency is
+// mostly what end_op() pays to commit.
+//
+//   writelat [nprocs [writes]]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define MAXP 8
+#define TIMEBASE 10  // time CSR ticks per microsecond in qemu
+
+char buf[1024];
+
+// a writer's results.
+struct lat {
+  uint64 total;
+  uint64 max;
+};
+
+void
+writer(int i, int nw, int fd)
+{
+  char name[3];
+  int wfd, j;
+  uint64 t0, t;
+  struct lat l;
+
+  name[0] = 'w';
+  name[1] = '0' + i;
+  name[2] = 0;
+  if((wfd = open(name, O_CREATE|O_WRONLY)) < 0){
+    fprintf(2, "writelat: can't create %s\n", name);
+    exit(1);
+  }
+  memset(buf, name[1], sizeof(buf));
+  l.total = l.max = 0;
+  for(j = 0; j < nw; j++){
+    t0 = r_time();
+    if(write(wfd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "writelat: write failed\n");
+      exit(1);
+    }
+    t = r_time() - t0;
+    l.total += t;
+    if(t > l.max)
+      l.max = t;
+  }
+  close(wfd);
+  unlink(name);
+  write(fd, &l, sizeof(l));
+  exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+  int np = 4, nw = 100, i, p[2], pid, xstatus;
+  uint64 total = 0, max = 0;
+  struct lat l;
+
+  if(argc > 1)
+    np = atoi(argv[1]);
+  if(argc > 2)
+    nw = atoi(argv[2]);
+  if(np < 1 || np > MAXP || nw < 1 || nw > 200){
+    fprintf(2, "usage: writelat [nprocs [writes]]\n");
+    exit(1);
+  }
+
+  if(pipe(p) < 0){
+    fprintf(2, "writelat: pipe failed\n");
+    exit(1);
+  }
+  for(i = 0; i < np; i++){
+    if((pid = fork()) < 0){
+      fprintf(2, "writelat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(p[0]);
+      writer(i, nw, p[1]);
+    }
+  }
+  close(p[1]);
+  for(i = 0; i < np; i++){
+    if(read(p[0], &l, sizeof(l)) != sizeof(l)){
+      fprintf(2, "writelat: a writer failed\n");
+      exit(1);
+    }
+    total += l.total;
+    if(l.max > max)
+      max = l.max;
+  }
+  for(i = 0; i < np; i++){
+    wait(&xstatus);
+    if(xstatus != 0)
+      exit(1);
+  }
+
+  printf("writelat: %d writers, %d writes each: average %d us, worst %d us\n",
+         np, nw, (int)(total / (np * nw) / TIMEBASE), (int)(max / TIMEBASE));
+  exit(0);
+}